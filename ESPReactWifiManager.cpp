@@ -1,4 +1,11 @@
 #include <ESPReactWifiManager.h>
+#include <ESPReactWifiManagerDns.h>
+#include <ESPReactWifiManagerFixedString.h>
+#include <ESPReactWifiManagerLog.h>
+#include <ESPReactWifiManagerQueue.h>
+#include <ESPReactWifiManagerSave.h>
+#include <ESPReactWifiManagerTask.h>
+#include <ESPReactWifiManagerTimers.h>
 
 #if defined(ESP8266)
 #include <ESP8266WiFi.h>
@@ -10,6 +17,8 @@ extern "C" {
 }
 
 typedef int wifi_ssid_count_t;
+typedef struct bss_info scan_info_t;
+typedef ESP8266WiFiScanClass wifi_scan_class_t;
 typedef uint8 wifi_cred_t;
 typedef struct station_config sta_config_t;
 #define esp_wifi_sta_wpa2_ent_set_identity wifi_station_set_enterprise_identity
@@ -25,419 +34,3374 @@ typedef struct station_config sta_config_t;
 #include <esp_wpa2.h>
 
 typedef int16_t wifi_ssid_count_t;
+typedef wifi_ap_record_t scan_info_t;
+typedef WiFiScanClass wifi_scan_class_t;
 typedef unsigned char wifi_cred_t;
 typedef wifi_sta_config_t sta_config_t;
 #define ENCRYPTION_NONE WIFI_AUTH_OPEN
 #define ENCRYPTION_ENT WIFI_AUTH_WPA2_ENTERPRISE
 #endif
 
-#include <Ticker.h>
-#include <DNSServer.h>
+#include <WiFiUdp.h>
 #include <ESPAsyncWebServer.h>
+#include <lwip/dhcp.h>
+#include <time.h>
 #include <algorithm>
 #include <memory>
+#include <new>
+#include <type_traits>
 
-#define ARDUINOJSON_ENABLE_PROGMEM 1
-#include <ArduinoJson.h>
-#include <AsyncJson.h>
+namespace {
+
+// long-lived settings, see ESPREACT_STATIC_MEMORY; capacities follow the SDK
+#if ESPREACT_STATIC_MEMORY
+template<size_t Capacity> using StateString = FixedString<Capacity>;
+#else
+template<size_t Capacity> using StateString = String;
+#endif
+
+ESPReactWifiManager *instance = nullptr;
+
+bool isConnecting = false;
+bool fallbackToAp = true;
+bool apIfNoCredentials = false;
+
+// read by connectState() from any task
+std::atomic<ESPReactWifiManager::ConnectState> currentConnectState { ESPReactWifiManager::ConnectState::Idle };
+void (*connectProgressCallback)(ESPReactWifiManager::ConnectState) = nullptr;
+
+// settle times previously spent in delay() inside connect()
+const uint32_t disconnectSettleTime = 1000;
+const uint32_t modeSwitchSettleTime = 1000;
+
+StateString<32> connectSsid;
+StateString<64> connectPassword;
+StateString<64> connectLogin;
+StateString<64> connectIdentity;
+StateString<17> connectBssid;
+
+// per-network station settings beyond the credentials
+struct StationOptions {
+    uint8_t channel;  // 0 scans all channels
+    uint32_t ip;      // 0 uses DHCP
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+StationOptions connectOptions = {};
+// WiFi.config() has to be undone before a network without static addressing
+bool staticIpApplied = false;
+
+StateString<32> connectApName;
+StateString<64> connectApPassword;
+
+// AP+STA provisioning: connects started while the soft AP is up keep it and
+// the captive DNS running, the AP goes down a while after the station got an
+// IP so the portal can show the result
+bool apStaProvisioning = false;
+uint32_t apShutdownDelay = 5000;
+bool apActive = false;
+bool provisioningConnect = false;
+
+// deferred work, run from loop() by the timer wheel
+enum Timer : uint8_t {
+    ConnectStepTimer,  // settle delays and fast connect timeout of the connect state machine
+    ReconnectTimer,    // retry after a disconnect, also from AP mode
+    ScanTimer,         // scheduleScan()
+    ScanPollTimer,     // async scan progress
+    RoamTimer,         // RSSI samples while connected
+    ApShutdownTimer,   // end of AP+STA provisioning
+    WifiListTimer,     // /wifiList body waiting for a response to finish
+    TimerCount
+};
+TimerWheel<TimerCount> timers;
+const uint32_t scanPollInterval = 10;
+
+void startTimer(Timer timer, uint32_t delayMs)
+{
+    timers.schedule(timer, millis(), delayMs);
+}
+
+// captive DNS on the AP, drained in loop() up to dnsBudget packets per call
+WiFiUDP dnsUdp;
+CaptiveDns captiveDns;
+bool dnsStarted = false;
+uint8_t dnsBudget = 16;
+uint8_t dnsPacket[CaptiveDns::BufferSize];
+void (*finishedCallback)(bool) = nullptr;
+void (*notFoundCallback)(AsyncWebServerRequest*) = nullptr;
+bool (*captiveCallback)(AsyncWebServerRequest*) = nullptr;
+
+// connectivity checks sent by phones and desktops right after joining the AP,
+// answered by CaptiveProbeHandler without going through notFoundHandler
+const char captiveProbes[][28] PROGMEM = {
+    "/generate_204",              // Android
+    "/gen_204",                   // Android
+    "/hotspot-detect.html",       // Apple
+    "/library/test/success.html", // Apple, older iOS
+    "/connecttest.txt",           // Windows 10+
+    "/ncsi.txt",                  // Windows
+    "/redirect",                  // Windows
+    "/fwlink",                    // Windows
+    "/canonical.html",            // Firefox
+    "/success.txt",               // Firefox
+    "/chrome-variations/seed",    // Chrome OS
+};
+
+const IPAddress apIP(8, 8, 8, 8);
+// http:// + AP IP + /wifi.html, filled in once by setupAP()
+char captivePortalUrl[40] = { 0 };
+uint32_t captiveProbeCount = 0;
+
+StateString<32> wifiHostname;
+
+// scan results are kept in two fixed pools: the published one served to
+// clients and the staging one filled by the scan in progress
+ESPReactWifiManager::WifiRecord wifiPools[2][ESPREACT_WIFI_MAX_RESULTS];
+size_t wifiPoolSize[2] = { 0, 0 };
+uint8_t publishedPool = 0;
+uint32_t stagingHashes[ESPREACT_WIFI_MAX_RESULTS];
+// open addressing table of staging indices + 1, 0 marks a free slot
+const size_t dedupTableSize = ESPREACT_WIFI_MAX_RESULTS * 4;
+uint8_t dedupTable[dedupTableSize];
+static_assert(ESPREACT_WIFI_MAX_RESULTS < 255, "dedup table stores indices in uint8_t");
+// /wifiList body, serialized once per completed scan. Responses in flight
+// hold their own reference, so a new scan never changes a body being sent.
+struct WifiListBody {
+    String json;
+    uint32_t generation;
+    uint32_t scannedAt;
+};
+std::shared_ptr<WifiListBody> wifiListBody;
+std::shared_ptr<WifiListBody> spareWifiListBody;
+uint32_t scanGeneration = 0;
+// a /wifiList response takes a few hundred ms to send
+const uint32_t wifiListRetryInterval = 100;
+
+// scheduled scans are skipped while the published results are younger than
+// the TTL: every scan takes the radio off-channel and stalls AP clients
+uint32_t scanCacheTtl = 30000;
+uint32_t scanCachedAt = 0;
+bool scanCached = false;
+// set by /wifiList?refresh=1 on the web server task, the scan starts in loop()
+std::atomic<bool> scanRefreshRequested { false };
+// lets a client that just joined the AP finish DHCP and its captive probe first
+const uint32_t apClientScanDelay = 1500;
+
+bool asyncScan = false;
+bool scanPerChannel = false;
+bool scanInProgress = false;
+uint8_t scanChannel = 0;
+uint8_t scanLastChannel = 0;
+void (*scanEventCallback)(ESPReactWifiManager::ScanEvent) = nullptr;
+
+// directed scans for one SSID share the scan machinery but not its results:
+// the strongest answer goes to whoever asked, the published list is kept
+enum class ProbePurpose : uint8_t {
+    None,
+    Connect,
+    Roam,
+    User
+};
+ProbePurpose probePurpose = ProbePurpose::None;
+char probeSsid[33];
+ESPReactWifiManager::WifiRecord probeBest;
+bool probeFound = false;
+// beginStation() joins the BSSID and channel the connect probe found
+bool probeHint = false;
+bool connectProbeEnabled = true;
+void (*probeCallback)(bool, const ESPReactWifiManager::WifiRecord&) = nullptr;
+// an AP answers a directed probe request within a few ms, the SDK default
+// dwell is 120 ms per channel
+const uint32_t probeDwellTime = 50;
+
+// probe() called from another task while the manager task runs
+struct QueuedProbe {
+    char ssid[33];
+    uint8_t channel;
+};
+SpscQueue<QueuedProbe, 2> probeRequests;
+
+// histogram bounds, see WifiMetrics
+const uint32_t connectTimeBounds[] = { 250, 500, 1000, 2000, 4000, 8000, 16000 };
+const uint32_t scanTimeBounds[] = { 500, 1000, 2000, 3000, 5000, 8000, 13000 };
+const uint32_t probeTimeBounds[] = { 25, 50, 100, 200, 500, 1000, 2000 };
+const uint32_t networkCountBounds[] = { 1, 2, 4, 8, 16, 32, 64 };
+const uint32_t retryCountBounds[] = { 0, 1, 2, 3, 5, 8, 13 };
+const uint32_t dnsBatchBounds[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+WifiMetrics wifiMetrics;
+bool metricsEndpoint = false;
+uint32_t connectBeganAt = 0;
+bool associated = false;
+// beginStation() calls, events carry the value from when they were captured;
+// a disconnect from before the current begin() belongs to an attempt that is over
+std::atomic<uint8_t> stationAttempt { 0 };
+// set when the manager disconnects a connected station itself, the SDK
+// reports that with ASSOC_LEAVE and may do so only after the next begin()
+bool selfDisconnectPending = false;
+// an attempt that neither associates nor gets a lease in time counts as failed
+uint32_t associateTimeout = 15000;
+uint32_t dhcpTimeout = 10000;
+uint32_t scanStartedAt = 0;
+
+uint32_t maxFreeBlock()
+{
+#if defined(ESP8266)
+    return ESP.getMaxFreeBlockSize();
+#else
+    return ESP.getMaxAllocHeap();
+#endif
+}
+
+void sampleHeap(HeapPhase phase)
+{
+    HeapSample& sample = wifiMetrics.heap[static_cast<uint8_t>(phase)];
+    sample.freeHeap = ESP.getFreeHeap();
+    sample.maxFreeBlock = maxFreeBlock();
+    if (sample.minFreeHeap == 0 || sample.freeHeap < sample.minFreeHeap) {
+        sample.minFreeHeap = sample.freeHeap;
+    }
+}
+
+void serveDns()
+{
+    uint8_t received = 0;
+    uint8_t answered = 0;
+    while (received < dnsBudget) {
+        int size = dnsUdp.parsePacket();
+        if (size <= 0) {
+            break;
+        }
+        ++received;
+        // oversize packets are dropped by the next parsePacket()
+        if (static_cast<size_t>(size) > CaptiveDns::MaxQuery) {
+            continue;
+        }
+        size_t length = captiveDns.answer(dnsPacket, dnsUdp.read(dnsPacket, size));
+        if (length == 0) {
+            continue;
+        }
+        dnsUdp.beginPacket(dnsUdp.remoteIP(), dnsUdp.remotePort());
+        dnsUdp.write(dnsPacket, length);
+        dnsUdp.endPacket();
+        ++answered;
+    }
+    if (received > 0) {
+        wifiMetrics.dnsQueries += answered;
+        wifiMetrics.dnsBatch.record(received);
+        if (received == dnsBudget) {
+            ++wifiMetrics.dnsBudgetHits;
+        }
+    }
+}
+
+void recordScan(size_t networks)
+{
+    ++wifiMetrics.scans;
+    wifiMetrics.scanMs.record(millis() - scanStartedAt);
+    wifiMetrics.scanNetworks.record(networks);
+    sampleHeap(HeapPhase::ScanDone);
+}
+
+// roaming: a smoothed RSSI below the threshold triggers a channel-by-channel
+// scan, a BSSID of the same SSID stronger by the hysteresis is then pinned
+bool roamingEnabled = false;
+int8_t roamThreshold = -75;
+uint8_t roamHysteresis = 8;
+uint32_t roamInterval = 60 * 1000;
+const uint32_t roamSampleInterval = 2000;
+uint32_t roamLastScan = 0;
+bool roamScanned = false;
+int16_t roamRssi = 0; // 0 until the first sample
+bool roamScanPending = false;
+bool roamPending = false;
+uint8_t roamTarget[6];
+ESPReactWifiManager::RoamStats roamCounters = {};
+void (*roamCallback)(int8_t, int8_t) = nullptr;
+
+uint8_t retryCount = 0;
+uint8_t retryLimit = 5;
+// the SDK may report a failed attempt more than once, it counts until the next begin()
+bool attemptFailed = false;
+// once the credentials got an IP, losing the network is never terminal
+bool credentialsWorked = false;
+// delays the quick retries, and adds jitter to the ones from the fallback AP
+Backoff reconnectBackoff({ 5000, 60 * 1000, 2.0f, BackoffJitter::Decorrelated });
+// each retry from the fallback AP takes the portal down for the attempt
+uint32_t apRetryInterval = 60 * 1000;
+
+#if defined(ESP8266)
+WiFiEventHandler wifiAssociatedHandler;
+WiFiEventHandler wifiConnectHandler;
+WiFiEventHandler wifiDisconnectHandler;
+
+enum : uint8_t {
+    STA_CONNECTED_EVENT,
+    STA_GOT_IP_EVENT,
+    STA_DISCONNECTED_EVENT
+};
+#endif
+
+// events are captured in the Wi-Fi event context and handled in loop()
+struct QueuedWifiEvent {
+    uint8_t event;
+    uint8_t reason;  // of a station disconnect
+    uint8_t attempt; // stationAttempt when captured
+};
+SpscQueue<QueuedWifiEvent, 16> wifiEvents;
+
+// with the manager task running, calls from other tasks are queued for it
+enum class TaskCommand : uint8_t {
+    Connect,
+    AutoConnect,
+    Disconnect,
+    StartAP,
+    Scan,
+    ScheduleScan
+};
+
+struct QueuedCommand {
+    TaskCommand command;
+    uint32_t argument;
+};
+SpscQueue<QueuedCommand, 8> taskCommands;
+
+#if defined(ESP32)
+ConnectivityTask connectivityTask;
+// DNS packets do not wake the task, the socket is polled while the AP is up
+const uint32_t taskDnsPollInterval = 10;
+const uint32_t taskMaxSleep = 1000;
+#endif
+
+void wakeTask()
+{
+#if defined(ESP32)
+    if (connectivityTask.running()) {
+        connectivityTask.wake();
+    }
+#endif
+}
+
+bool fromOtherTask()
+{
+#if defined(ESP32)
+    return connectivityTask.running() && !connectivityTask.isCurrent();
+#else
+    return false;
+#endif
+}
+
+bool queueCommand(TaskCommand command, uint32_t argument = 0)
+{
+    QueuedCommand queued = { command, argument };
+    bool queuedOk = taskCommands.push(queued);
+    if (!queuedOk) {
+        WM_LOGW("Command queue full");
+    }
+    wakeTask();
+    return queuedOk;
+}
+
+struct FastConnectRecord {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint32_t ssidHash;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns1;
+    uint32_t dns2;
+    uint32_t leaseSeconds; // 0 when the address did not come from DHCP
+    uint32_t leaseStart;   // epoch seconds, 0 without a clock
+    uint32_t checksum;
+};
+
+const uint32_t fastConnectMagic = 0x57464331; // "WFC1"
+const uint8_t fastConnectVersion = 2;
+const char fastConnectFile[] = "/wifi.fast";
+// full scan + DHCP path is taken when cached channel/BSSID did not answer in time
+const uint32_t fastConnectTimeout = 1500;
+
+bool fastConnectEnabled = false;
+bool fastConnectStaticIp = false;
+bool fastConnectLoaded = false;
+bool fastConnectValid = false;
+bool fastConnectAttempt = false;
+bool fastConnectSkip = false;
+FastConnectRecord fastConnectRecord;
+// the attempt runs on the cached lease, it is not renewed while in use
+bool fastConnectCachedIp = false;
+// start of the cached lease on millis(), when it was obtained since boot
+bool fastConnectLeaseTimed = false;
+uint32_t fastConnectLeaseAt = 0;
+
+bool signalLess(const ESPReactWifiManager::WifiRecord& a,
+                const ESPReactWifiManager::WifiRecord& b)
+{
+    return a.rssi > b.rssi;
+}
+
+// exposes the SDK scan records, getNetworkInfo() copies every SSID into a String
+struct ScanInfoAccess : public wifi_scan_class_t {
+    using wifi_scan_class_t::_getScanInfoByIndex;
+};
+
+uint32_t fnv1a(const uint8_t* data, size_t length, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// station SSID from the SDK config, WiFi.SSID() would build a String
+const char* stationSsid(char (&ssid)[33])
+{
+#if defined(ESP32)
+    wifi_config_t conf;
+    esp_wifi_get_config(WIFI_IF_STA, &conf);
+    memcpy(ssid, conf.sta.ssid, 32);
+#else
+    struct station_config conf;
+    wifi_station_get_config(&conf);
+    memcpy(ssid, conf.ssid, 32);
+#endif
+    ssid[32] = 0;
+    return ssid;
+}
+
+// String assignments from nullptr leave an invalid String on the Arduino cores
+const char* orEmpty(const char* value)
+{
+    return value ? value : "";
+}
+
+const char* formatMac(char (&out)[18], const uint8_t* mac)
+{
+    static const uint8_t none[6] = { 0 };
+    if (!mac) {
+        mac = none;
+    }
+    snprintf_P(out, sizeof(out), PSTR("%02X:%02X:%02X:%02X:%02X:%02X"),
+               mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return out;
+}
+
+const char* formatIp(char (&out)[16], const IPAddress& ip)
+{
+    snprintf_P(out, sizeof(out), PSTR("%u.%u.%u.%u"), ip[0], ip[1], ip[2], ip[3]);
+    return out;
+}
+
+bool checkScanCount(wifi_ssid_count_t n)
+{
+    if (n == WIFI_SCAN_FAILED) {
+        WM_LOGW("scanNetworks returned: WIFI_SCAN_FAILED!");
+        return false;
+    } else if (n == WIFI_SCAN_RUNNING) {
+        WM_LOGW("scanNetworks returned: WIFI_SCAN_RUNNING!");
+        return false;
+    } else if (n < 0) {
+        WM_LOGW("scanNetworks failed with unknown error code: %d", n);
+        return false;
+    } else if (n == 0) {
+        WM_LOGI("No networks found");
+        return false;
+    }
+
+    WM_LOGI("Found networks: %d", n);
+    return true;
+}
+
+ESPReactWifiManager::WifiRecord* stagingPool()
+{
+    return wifiPools[publishedPool ^ 1];
+}
+
+#if !defined(ESP8266)
+// ESP32 scan records have no hidden flag: broad scans list hidden networks
+// without an SSID, a probe answer from one of these BSSIDs is hidden
+uint8_t hiddenBssids[8][6];
+size_t hiddenBssidCount = 0;
+
+bool isHiddenBssid(const uint8_t* bssid)
+{
+    for (size_t i = 0; i < hiddenBssidCount; ++i) {
+        if (memcmp(hiddenBssids[i], bssid, sizeof(hiddenBssids[i])) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void addHiddenBssid(const uint8_t* bssid)
+{
+    if (hiddenBssidCount < sizeof(hiddenBssids) / sizeof(hiddenBssids[0]) && !isHiddenBssid(bssid)) {
+        memcpy(hiddenBssids[hiddenBssidCount++], bssid, sizeof(hiddenBssids[0]));
+    }
+}
+#endif
+
+void resetStaging()
+{
+    wifiPoolSize[publishedPool ^ 1] = 0;
+    memset(dedupTable, 0, sizeof(dedupTable));
+#if !defined(ESP8266)
+    hiddenBssidCount = 0;
+#endif
+}
+
+void rebuildDedupTable()
+{
+    memset(dedupTable, 0, sizeof(dedupTable));
+    for (size_t i = 0; i < wifiPoolSize[publishedPool ^ 1]; ++i) {
+        size_t slot = stagingHashes[i] % dedupTableSize;
+        while (dedupTable[slot]) {
+            slot = (slot + 1) % dedupTableSize;
+        }
+        dedupTable[slot] = i + 1;
+    }
+}
+
+// single pass dedup: keeps the strongest BSSID per SSID, and the strongest
+// SSIDs once the pool is full
+void addScanRecord(const ESPReactWifiManager::WifiRecord& record, uint32_t hash)
+{
+    ESPReactWifiManager::WifiRecord* pool = stagingPool();
+    size_t& size = wifiPoolSize[publishedPool ^ 1];
+
+    size_t slot = hash % dedupTableSize;
+    for (size_t probe = 0; probe < dedupTableSize && dedupTable[slot]; ++probe) {
+        size_t index = dedupTable[slot] - 1;
+        if (stagingHashes[index] == hash && strcmp(pool[index].ssid, record.ssid) == 0) {
+            if (record.rssi > pool[index].rssi) {
+                pool[index] = record;
+            }
+            return;
+        }
+        slot = (slot + 1) % dedupTableSize;
+    }
+
+    size_t index = size;
+    if (size < ESPREACT_WIFI_MAX_RESULTS) {
+        ++size;
+    } else {
+        index = 0;
+        for (size_t i = 1; i < size; ++i) {
+            if (pool[i].rssi < pool[index].rssi) {
+                index = i;
+            }
+        }
+        if (pool[index].rssi >= record.rssi) {
+            return;
+        }
+    }
+
+    pool[index] = record;
+    stagingHashes[index] = hash;
+
+    // replaced records leave stale slots behind, they are purged when the table fills up
+    if (dedupTable[slot]) {
+        rebuildDedupTable();
+        return;
+    }
+    dedupTable[slot] = index + 1;
+}
+
+// false for entries without an SSID, hidden networks only have one in the
+// answer to a directed probe
+bool readScanRecord(wifi_ssid_count_t i, ESPReactWifiManager::WifiRecord& record, size_t& ssidLength)
+{
+    const scan_info_t* info = reinterpret_cast<const scan_info_t*>(ScanInfoAccess::_getScanInfoByIndex(i));
+    if (!info) {
+        WM_LOGW("Error getNetworkInfo for %d", i);
+        return false;
+    }
+
+#if defined(ESP8266)
+    ssidLength = std::min<size_t>(info->ssid_len, sizeof(info->ssid));
+    record.channel = info->channel;
+    record.isHidden = info->is_hidden;
+#else
+    ssidLength = strnlen(reinterpret_cast<const char*>(info->ssid), sizeof(record.ssid) - 1);
+    record.channel = info->primary;
+    record.isHidden = isHiddenBssid(info->bssid);
+    if (ssidLength == 0 && probePurpose == ProbePurpose::None) {
+        addHiddenBssid(info->bssid);
+    }
+#endif
+    if (ssidLength == 0) {
+        return false;
+    }
+
+    memcpy(record.ssid, info->ssid, ssidLength);
+    record.ssid[ssidLength] = '\0';
+    memcpy(record.bssid, info->bssid, sizeof(record.bssid));
+    record.rssi = info->rssi;
+    record.encryptionType = WiFi.encryptionType(i);
+
+    if (record.rssi <= -100) {
+        record.quality = 0;
+    } else if (record.rssi >= -50) {
+        record.quality = 100;
+    } else {
+        record.quality = 2 * (record.rssi + 100);
+    }
+    return true;
+}
+
+void readProbeResults(wifi_ssid_count_t n)
+{
+    for (wifi_ssid_count_t i = 0; i < n; i++) {
+        ESPReactWifiManager::WifiRecord record;
+        size_t ssidLength;
+        if (!readScanRecord(i, record, ssidLength) || strcmp(record.ssid, probeSsid) != 0) {
+            continue;
+        }
+        if (!probeFound || record.rssi > probeBest.rssi) {
+            probeBest = record;
+            probeFound = true;
+        }
+    }
+}
+
+void readScanResults(wifi_ssid_count_t n)
+{
+    for (wifi_ssid_count_t i = 0; i < n; i++) {
+        ESPReactWifiManager::WifiRecord record;
+        size_t ssidLength;
+        if (!readScanRecord(i, record, ssidLength)) {
+            continue;
+        }
+
+        WM_LOGV("index: %d ssid: %s bssid: %02X:%02X:%02X:%02X:%02X:%02X", i, record.ssid
+                , record.bssid[0]
+                , record.bssid[1]
+                , record.bssid[2]
+                , record.bssid[3]
+                , record.bssid[4]
+                , record.bssid[5]);
+
+        addScanRecord(record, fnv1a(reinterpret_cast<const uint8_t*>(record.ssid), ssidLength));
+    }
+}
+
+void publishScanResults()
+{
+    ESPReactWifiManager::WifiRecord* pool = stagingPool();
+    std::sort(pool, pool + wifiPoolSize[publishedPool ^ 1], signalLess);
+    publishedPool ^= 1;
+}
+
+const __FlashStringHelper* securityName(uint8_t encryptionType)
+{
+    if (encryptionType == ENCRYPTION_NONE) {
+        return F("none");
+    } else if (encryptionType == ENCRYPTION_ENT) {
+        return F("WPA2");
+    }
+    return F("WEP");
+}
+
+// appendJsonString() into a fixed buffer, an escape that does not fit ends the value
+const char* writeJsonString(char* out, size_t size, const char* value)
+{
+    size_t length = 0;
+    out[length++] = '"';
+    for (; *value; ++value) {
+        char c = *value;
+        char escaped[7] = { c, 0 };
+        if (c == '"' || c == '\\') {
+            escaped[0] = '\\';
+            escaped[1] = c;
+            escaped[2] = 0;
+        } else if (static_cast<uint8_t>(c) < 0x20) {
+            snprintf_P(escaped, sizeof(escaped), PSTR("\\u%04x"), c);
+        }
+        size_t escapedLength = strlen(escaped);
+        if (length + escapedLength + 2 > size) {
+            break;
+        }
+        memcpy(out + length, escaped, escapedLength);
+        length += escapedLength;
+    }
+    out[length++] = '"';
+    out[length] = 0;
+    return out;
+}
+
+void appendJsonString(String& out, const char* value)
+{
+    out += '"';
+    for (; *value; ++value) {
+        char c = *value;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<uint8_t>(c) < 0x20) {
+            char escaped[7];
+            snprintf_P(escaped, sizeof(escaped), PSTR("\\u%04x"), c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void appendWifiEntry(String& json, const ESPReactWifiManager::WifiRecord& result)
+{
+    json += F("{\"ssid\":");
+    appendJsonString(json, result.ssid);
+    json += F(",\"signalStrength\":");
+    json += result.quality;
+    json += F(",\"security\":\"");
+    json += securityName(result.encryptionType);
+    json += F("\"}");
+}
+
+// fills the spare body from the published results and swaps it in; false
+// while a response still sends the spare and it cannot be replaced
+bool publishWifiList()
+{
+    // 48 bytes covers keys, punctuation, quality and security of one entry
+    const ESPReactWifiManager::WifiRecord* pool = wifiPools[publishedPool];
+    size_t count = wifiPoolSize[publishedPool];
+
+    size_t capacity = 2;
+    for (size_t i = 0; i < count; ++i) {
+        capacity += 48 + strlen(pool[i].ssid);
+    }
+#if ESPREACT_STATIC_MEMORY
+    // sized for a full scan up front, later scans never grow the buffer
+    capacity = std::max(capacity, static_cast<size_t>(2 + ESPREACT_WIFI_MAX_RESULTS * (48 + 32)));
+#endif
+
+    // the spare is unpublished, nobody else can take a reference to it
+    if (!spareWifiListBody || spareWifiListBody.use_count() > 1) {
+#if ESPREACT_STATIC_MEMORY
+        // the first two scans make both bodies, later ones wait for the response
+        if (spareWifiListBody) {
+            return false;
+        }
+#endif
+        spareWifiListBody = std::make_shared<WifiListBody>();
+    }
+
+    String& json = spareWifiListBody->json;
+    json = "";
+    json.reserve(capacity);
+    json += '[';
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            json += ',';
+        }
+        appendWifiEntry(json, pool[i]);
+    }
+    json += ']';
+    spareWifiListBody->generation = scanGeneration;
+    spareWifiListBody->scannedAt = scanCachedAt;
+
+    spareWifiListBody = std::atomic_exchange(&wifiListBody, spareWifiListBody);
+    return true;
+}
+
+void serializeWifiList()
+{
+    ++scanGeneration;
+    scanCachedAt = millis();
+    scanCached = true;
+    if (publishWifiList()) {
+        timers.cancel(WifiListTimer);
+    } else {
+        startTimer(WifiListTimer, wifiListRetryInterval);
+    }
+}
+
+// portal UI served from flash, see setPortalAssets()
+const PortalAsset* portalAssets = nullptr;
+size_t portalAssetCount = 0;
+// copied out of PROGMEM, findPortalAsset() compares a RAM path to the table
+char portalDefaultPath[64] = "";
+const char portalIndexPath[] PROGMEM = "/wifi.html";
+
+// table is sorted by path, entries are copied out of PROGMEM one at a time
+bool findPortalAsset(const char* path, PortalAsset& asset)
+{
+    size_t low = 0;
+    size_t high = portalAssetCount;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        memcpy_P(&asset, &portalAssets[middle], sizeof(asset));
+        int order = strcmp_P(path, asset.path);
+        if (order == 0) {
+            return true;
+        } else if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return false;
+}
+
+void sendPortalAsset(AsyncWebServerRequest* request, const PortalAsset& asset)
+{
+    AsyncWebHeader* ifNoneMatch = request->getHeader(F("If-None-Match"));
+    if (ifNoneMatch && strcmp_P(ifNoneMatch->value().c_str(), asset.etag) == 0) {
+        request->send(304);
+        return;
+    }
+
+    // HEAD gets the headers of GET without the body
+    AsyncWebServerResponse* response = request->method() == HTTP_HEAD
+            ? request->beginResponse(200, String(FPSTR(asset.contentType)))
+            : request->beginResponse_P(200, String(FPSTR(asset.contentType)), asset.data, asset.length);
+    if (asset.gzip) {
+        response->addHeader(F("Content-Encoding"), F("gzip"));
+    }
+    response->addHeader(F("ETag"), String(FPSTR(asset.etag)));
+    // unhashed files such as wifi.html are revalidated with the ETag
+    response->addHeader(F("Cache-Control"), asset.immutable
+                        ? F("public, max-age=31536000, immutable")
+                        : F("no-cache"));
+    request->send(response);
+}
+
+bool sendDefaultPortalAsset(AsyncWebServerRequest* request)
+{
+    PortalAsset asset;
+    if (!findPortalAsset(portalDefaultPath, asset)) {
+        return false;
+    }
+    sendPortalAsset(request, asset);
+    return true;
+}
+
+// other requests may be matched between canHandle() and handleRequest(),
+// both look the asset up from the URL
+class PortalAssetHandler : public AsyncWebHandler
+{
+public:
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        if (!portalAssets || !(request->method() & (HTTP_GET | HTTP_HEAD))) {
+            return false;
+        }
+        PortalAsset asset;
+        if (!findPortalAsset(assetPath(request), asset)) {
+            return false;
+        }
+        request->addInterestingHeader(F("If-None-Match"));
+        return true;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        PortalAsset asset;
+        if (!findPortalAsset(assetPath(request), asset)) {
+            // setPortalAssets() replaced the table since canHandle()
+            request->send(404);
+            return;
+        }
+        sendPortalAsset(request, asset);
+    }
+
+private:
+    static const char* assetPath(AsyncWebServerRequest* request)
+    {
+        return request->url() == F("/") ? portalDefaultPath : request->url().c_str();
+    }
+};
+
+// pushed to the portal over /wifiEvents; payloads are only built while a
+// client is listening
+AsyncEventSource* eventSource = nullptr;
+
+bool hasEventClients()
+{
+    return eventSource && eventSource->count() > 0;
+}
+
+const ESPReactWifiManager::WifiRecord* findRecord(const ESPReactWifiManager::WifiRecord* pool,
+                                                  size_t count, const char* ssid)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(pool[i].ssid, ssid) == 0) {
+            return &pool[i];
+        }
+    }
+    return nullptr;
+}
+
+#if ESPREACT_STATIC_MEMORY
+// built on the loop task only, the connect events below are sent from the
+// web server task too and use the stack
+String scanDeltaJson;
+#endif
+
+// entries that are new or changed since the previous scan, whose pool is
+// still intact until the next scan starts
+void pushScanDelta()
+{
+    if (!hasEventClients()) {
+        return;
+    }
+
+    const ESPReactWifiManager::WifiRecord* current = wifiPools[publishedPool];
+    size_t currentCount = wifiPoolSize[publishedPool];
+    const ESPReactWifiManager::WifiRecord* previous = wifiPools[publishedPool ^ 1];
+    size_t previousCount = wifiPoolSize[publishedPool ^ 1];
+
+#if ESPREACT_STATIC_MEMORY
+    // reserved for every entry changed and removed at once, kept between deltas
+    String& json = scanDeltaJson;
+    json = "";
+    json.reserve(64 + ESPREACT_WIFI_MAX_RESULTS * (48 + 32 + 32 + 3));
+#else
+    String json;
+#endif
+    json += F("{\"generation\":");
+    json += scanGeneration;
+    json += F(",\"changed\":[");
+    bool first = true;
+    for (size_t i = 0; i < currentCount; ++i) {
+        const ESPReactWifiManager::WifiRecord* old = findRecord(previous, previousCount, current[i].ssid);
+        // signal jitter below 10% is not worth a push
+        if (old && abs(old->quality - current[i].quality) < 10 && old->encryptionType == current[i].encryptionType) {
+            continue;
+        }
+        if (!first) {
+            json += ',';
+        }
+        first = false;
+        appendWifiEntry(json, current[i]);
+    }
+    json += F("],\"removed\":[");
+    first = true;
+    for (size_t i = 0; i < previousCount; ++i) {
+        if (findRecord(current, currentCount, previous[i].ssid)) {
+            continue;
+        }
+        if (!first) {
+            json += ',';
+        }
+        first = false;
+        appendJsonString(json, previous[i].ssid);
+    }
+    json += F("]}");
+    eventSource->send(json.c_str(), "scan");
+}
+
+void appendHistogram(String& json, const __FlashStringHelper* name, const MetricHistogram& histogram)
+{
+    json += '"';
+    json += name;
+    json += F("\":{\"bounds\":[");
+    for (uint8_t i = 0; i < MetricHistogram::Buckets - 1; ++i) {
+        if (i > 0) {
+            json += ',';
+        }
+        json += histogram.bounds()[i];
+    }
+    json += F("],\"buckets\":[");
+    for (uint8_t i = 0; i < MetricHistogram::Buckets; ++i) {
+        if (i > 0) {
+            json += ',';
+        }
+        json += histogram.bucket(i);
+    }
+    char tail[64];
+    snprintf_P(tail, sizeof(tail), PSTR("],\"count\":%u,\"sum\":%u,\"max\":%u}"),
+               static_cast<unsigned>(histogram.count()), static_cast<unsigned>(histogram.sum()),
+               static_cast<unsigned>(histogram.max()));
+    json += tail;
+}
+
+void serializeMetrics(String& json)
+{
+    static const char* const phases[] = {
+        "connectStart", "associated", "gotIp", "scanDone", "apStarted"
+    };
+    char buffer[96];
+
+    json.reserve(1024);
+    json += F("{\"counters\":{");
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"connectAttempts\":%u,\"connects\":%u,\"disconnects\":%u,"),
+               static_cast<unsigned>(wifiMetrics.connectAttempts), static_cast<unsigned>(wifiMetrics.connects),
+               static_cast<unsigned>(wifiMetrics.disconnects));
+    json += buffer;
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"apFallbacks\":%u,\"connectTimeouts\":%u,"),
+               static_cast<unsigned>(wifiMetrics.apFallbacks), static_cast<unsigned>(wifiMetrics.connectTimeouts));
+    json += buffer;
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"scans\":%u,\"scanFailures\":%u,"),
+               static_cast<unsigned>(wifiMetrics.scans), static_cast<unsigned>(wifiMetrics.scanFailures));
+    json += buffer;
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"scanCacheHits\":%u,\"scansCoalesced\":%u,"),
+               static_cast<unsigned>(wifiMetrics.scanCacheHits), static_cast<unsigned>(wifiMetrics.scansCoalesced));
+    json += buffer;
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"wifiListRequests\":%u,\"wifiListNotModified\":%u,"),
+               static_cast<unsigned>(wifiMetrics.wifiListRequests),
+               static_cast<unsigned>(wifiMetrics.wifiListNotModified));
+    json += buffer;
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"wifiListBytes\":%u,\"dnsQueries\":%u,\"dnsBudgetHits\":%u,"),
+               static_cast<unsigned>(wifiMetrics.wifiListBytes), static_cast<unsigned>(wifiMetrics.dnsQueries),
+               static_cast<unsigned>(wifiMetrics.dnsBudgetHits));
+    json += buffer;
+    snprintf_P(buffer, sizeof(buffer), PSTR("\"captiveProbes\":%u},"), static_cast<unsigned>(captiveProbeCount));
+    json += buffer;
+
+    json += F("\"histograms\":{");
+    appendHistogram(json, F("associateMs"), wifiMetrics.associateMs);
+    json += ',';
+    appendHistogram(json, F("ipMs"), wifiMetrics.ipMs);
+    json += ',';
+    appendHistogram(json, F("scanMs"), wifiMetrics.scanMs);
+    json += ',';
+    appendHistogram(json, F("scanNetworks"), wifiMetrics.scanNetworks);
+    json += ',';
+    appendHistogram(json, F("probeMs"), wifiMetrics.probeMs);
+    json += ',';
+    appendHistogram(json, F("retries"), wifiMetrics.retries);
+    json += ',';
+    appendHistogram(json, F("dnsBatch"), wifiMetrics.dnsBatch);
+    json += F("},\"heap\":{");
+    for (uint8_t i = 0; i < static_cast<uint8_t>(HeapPhase::Count); ++i) {
+        const HeapSample& sample = wifiMetrics.heap[i];
+        snprintf_P(buffer, sizeof(buffer), PSTR("%s\"%s\":{\"free\":%u,\"maxBlock\":%u,\"minFree\":%u}"),
+                   i > 0 ? "," : "", phases[i], static_cast<unsigned>(sample.freeHeap),
+                   static_cast<unsigned>(sample.maxFreeBlock), static_cast<unsigned>(sample.minFreeHeap));
+        json += buffer;
+    }
+    snprintf_P(buffer, sizeof(buffer), PSTR("},\"freeHeap\":%u,\"maxFreeBlock\":%u}"),
+               static_cast<unsigned>(ESP.getFreeHeap()), static_cast<unsigned>(maxFreeBlock()));
+    json += buffer;
+}
+
+class WifiListHandler : public AsyncWebHandler
+{
+public:
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        if (request->method() != HTTP_GET || request->url() != F("/wifiList")) {
+            return false;
+        }
+        // headers not requested by a handler are dropped before handleRequest()
+        request->addInterestingHeader(F("If-None-Match"));
+        return true;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        WM_LOGD("wifiList count: %u", static_cast<unsigned>(wifiPoolSize[publishedPool]));
+
+        std::shared_ptr<WifiListBody> body = std::atomic_load(&wifiListBody);
+        bool scanned = static_cast<bool>(body);
+        if (!body) {
+            body = std::make_shared<WifiListBody>();
+            body->json = F("[]");
+            body->generation = scanGeneration;
+            body->scannedAt = 0;
+        }
+
+        // refresh=1 rescans only when the results are stale; the current ones
+        // are answered at once and the new ones arrive as scan deltas on
+        // /wifiEvents or with the next request
+        uint32_t age = millis() - body->scannedAt;
+        bool refreshing = false;
+        AsyncWebParameter* refresh = request->getParam(F("refresh"));
+        if (refresh && refresh->value() == F("1") && (!scanned || age >= scanCacheTtl)) {
+            scanRefreshRequested = true;
+            wakeTask();
+            refreshing = true;
+        }
+
+        char etag[12];
+        snprintf_P(etag, sizeof(etag), PSTR("\"%08x\""), static_cast<unsigned>(body->generation));
+
+        ++wifiMetrics.wifiListRequests;
+        AsyncWebServerResponse* response;
+        AsyncWebHeader* ifNoneMatch = request->getHeader(F("If-None-Match"));
+        if (ifNoneMatch && ifNoneMatch->value() == etag) {
+            ++wifiMetrics.wifiListNotModified;
+            response = request->beginResponse(304);
+        } else {
+            wifiMetrics.wifiListBytes += body->json.length();
+
+            // the filler index is this response's own cursor into its snapshot
+            response = request->beginResponse(
+                F("application/json"), body->json.length(),
+                [body](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                    if (index >= body->json.length()) {
+                        return 0;
+                    }
+                    size_t len = std::min(maxLen, body->json.length() - index);
+                    memcpy(buffer, body->json.c_str() + index, len);
+                    return len;
+                });
+        }
+        response->addHeader(F("ETag"), etag);
+        response->addHeader(F("Cache-Control"), F("no-cache"));
+        // seconds since the results were scanned, absent before the first scan
+        if (scanned) {
+            char seconds[11];
+            snprintf_P(seconds, sizeof(seconds), PSTR("%u"), static_cast<unsigned>(age / 1000));
+            response->addHeader(F("X-Scan-Age"), seconds);
+        }
+        if (refreshing) {
+            response->addHeader(F("X-Scan-Pending"), F("1"));
+        }
+        request->send(response);
+    }
+};
+
+void notifyScanEvent(ESPReactWifiManager::ScanEvent event)
+{
+    if (scanEventCallback) {
+        scanEventCallback(event);
+    }
+}
+
+void scanChannelRange(uint8_t& first, uint8_t& last)
+{
+    wifi_country_t country;
+#if defined(ESP8266)
+    bool ok = wifi_get_country(&country);
+#else
+    bool ok = esp_wifi_get_country(&country) == ESP_OK;
+#endif
+    if (ok && country.nchan > 0) {
+        first = country.schan;
+        last = country.schan + country.nchan - 1;
+    } else {
+        first = 1;
+        last = 13;
+    }
+}
+
+// ssid makes it a directed scan: probe requests carry the SSID, so hidden
+// networks answer too, and other networks are left out of the results
+bool startChannelScan(uint8_t channel, const char* ssid = nullptr)
+{
+#if defined(ESP8266)
+    return WiFi.scanNetworks(true, ssid != nullptr, channel,
+                             reinterpret_cast<uint8*>(const_cast<char*>(ssid))) == WIFI_SCAN_RUNNING;
+#else
+    // hidden networks are listed too, without an SSID, see readScanRecord()
+    if (channel == 0 && !ssid) {
+        return WiFi.scanNetworks(true, true) == WIFI_SCAN_RUNNING;
+    }
+
+    // Arduino core scanNetworks() can neither limit a scan to one channel nor
+    // direct it, results are still collected by WiFiScanClass on SCAN_DONE event
+    WiFi.scanDelete();
+    wifi_scan_config_t config = {};
+    config.channel = channel;
+    config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    config.show_hidden = true;
+    if (ssid) {
+        config.ssid = reinterpret_cast<uint8_t*>(const_cast<char*>(ssid));
+        config.scan_time.active.max = probeDwellTime;
+    }
+    WiFiGenericClass::setStatusBits(WIFI_SCANNING_BIT);
+    if (esp_wifi_scan_start(&config, false) != ESP_OK) {
+        WiFiGenericClass::clearStatusBits(WIFI_SCANNING_BIT);
+        return false;
+    }
+    return true;
+#endif
+}
+
+void finishProbe();
+
+// first to last one channel per step, or all at once when last is 0
+bool launchScan(uint8_t first, uint8_t last, const char* ssid)
+{
+    if (!startChannelScan(first, ssid)) {
+        return false;
+    }
+    scanChannel = first;
+    scanLastChannel = last;
+    scanInProgress = true;
+    scanStartedAt = millis();
+    startTimer(ScanPollTimer, scanPollInterval);
+    return true;
+}
+
+bool startScan(bool perChannel)
+{
+    if (scanInProgress) {
+        WM_LOGD("Scan already in progress");
+        return false;
+    }
+
+    resetStaging();
+
+    uint8_t channel = 0;
+    uint8_t lastChannel = 0;
+    if (perChannel) {
+        scanChannelRange(channel, lastChannel);
+    }
+
+    if (!launchScan(channel, lastChannel, nullptr)) {
+        WM_LOGW("Error starting scan");
+        notifyScanEvent(ESPReactWifiManager::ScanEvent::Failed);
+        return false;
+    }
+
+    notifyScanEvent(ESPReactWifiManager::ScanEvent::Started);
+    return true;
+}
+
+bool startProbe(ProbePurpose purpose, const char* ssid, uint8_t channel, bool perChannel)
+{
+    if (scanInProgress) {
+        WM_LOGD("Scan in progress, not probing for %s", ssid);
+        return false;
+    }
+
+    strncpy(probeSsid, ssid, sizeof(probeSsid) - 1);
+    probeSsid[sizeof(probeSsid) - 1] = '\0';
+    probeFound = false;
+
+    uint8_t first = channel;
+    uint8_t last = channel;
+    if (channel == 0 && perChannel) {
+        scanChannelRange(first, last);
+    }
+    if (!launchScan(first, last, probeSsid)) {
+        WM_LOGW("Error starting probe for %s", probeSsid);
+        return false;
+    }
+    probePurpose = purpose;
+    WM_LOGD("Probing for %s on channel %u", probeSsid, channel);
+    return true;
+}
+
+void pollScan()
+{
+    wifi_ssid_count_t n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) {
+        return;
+    }
+
+    bool probing = probePurpose != ProbePurpose::None;
+    if (n > 0) {
+        if (probing) {
+            readProbeResults(n);
+        } else {
+            readScanResults(n);
+        }
+    } else if (n < 0) {
+        WM_LOGW("Scan failed on channel: %u", scanChannel);
+    }
+
+    if (scanChannel < scanLastChannel) {
+        if (startChannelScan(++scanChannel, probing ? probeSsid : nullptr)) {
+            return;
+        }
+        WM_LOGW("Error starting scan on channel: %u", scanChannel);
+    }
+
+    WiFi.scanDelete();
+    scanInProgress = false;
+    if (probing) {
+        wifiMetrics.probeMs.record(millis() - scanStartedAt);
+        finishProbe();
+        return;
+    }
+    WM_LOGD("Scan done");
+
+    if (!checkScanCount(static_cast<wifi_ssid_count_t>(wifiPoolSize[publishedPool ^ 1]))) {
+        ++wifiMetrics.scanFailures;
+        notifyScanEvent(ESPReactWifiManager::ScanEvent::Failed);
+        return;
+    }
+
+    publishScanResults();
+    recordScan(wifiPoolSize[publishedPool]);
+    serializeWifiList();
+    pushScanDelta();
+    notifyScanEvent(ESPReactWifiManager::ScanEvent::Completed);
+}
+
+void pollRoaming(uint32_t now)
+{
+    if (!roamingEnabled || currentConnectState != ESPReactWifiManager::ConnectState::Connected
+            || WiFi.status() != WL_CONNECTED) {
+        roamRssi = 0;
+        return;
+    }
+    startTimer(RoamTimer, roamSampleInterval);
+
+    int8_t rssi = WiFi.RSSI();
+    if (rssi == 0) {
+        return;
+    }
+    roamRssi = roamRssi == 0 ? rssi : (roamRssi * 3 + rssi) / 4;
+
+    if (roamRssi >= roamThreshold || scanInProgress || roamScanPending
+            || (roamScanned && now - roamLastScan < roamInterval)) {
+        return;
+    }
+
+    roamScanned = true;
+    roamLastScan = now;
+    WM_LOGD("Signal %d dBm below %d dBm, looking for a better BSSID", roamRssi, roamThreshold);
+    // one channel per loop() tick, the link is served in between
+    char ssid[33];
+    if (startProbe(ProbePurpose::Roam, stationSsid(ssid), 0, true)) {
+        roamScanPending = true;
+        ++roamCounters.scans;
+    }
+}
+
+void finishRoamScan()
+{
+    if (!roamScanPending) {
+        return;
+    }
+    roamScanPending = false;
+
+    char ssid[33];
+    if (!probeFound || currentConnectState != ESPReactWifiManager::ConnectState::Connected
+            || strcmp(stationSsid(ssid), probeSsid) != 0) {
+        return;
+    }
+
+    // the probe keeps the strongest BSSID that answered
+    const ESPReactWifiManager::WifiRecord& record = probeBest;
+    const uint8_t* current = WiFi.BSSID();
+    if ((current && memcmp(record.bssid, current, sizeof(record.bssid)) == 0)
+            || record.rssi < roamRssi + roamHysteresis) {
+        return;
+    }
+    WM_LOGI("Roaming from %d dBm to %02X:%02X:%02X:%02X:%02X:%02X at %d dBm", roamRssi,
+            record.bssid[0], record.bssid[1], record.bssid[2],
+            record.bssid[3], record.bssid[4], record.bssid[5], record.rssi);
+    memcpy(roamTarget, record.bssid, sizeof(roamTarget));
+    roamCounters.rssiBefore = roamRssi;
+    roamPending = true;
+    instance->connect();
+}
+
+uint32_t fastConnectChecksum(const FastConnectRecord& record)
+{
+    return fnv1a(reinterpret_cast<const uint8_t*>(&record), offsetof(FastConnectRecord, checksum));
+}
+
+uint32_t ssidHash(const char* ssid)
+{
+    return fnv1a(reinterpret_cast<const uint8_t*>(ssid), strlen(ssid));
+}
+
+bool loadFastConnect()
+{
+    if (fastConnectLoaded) {
+        return fastConnectValid;
+    }
+    fastConnectLoaded = true;
+    fastConnectValid = false;
+
+    File file = SPIFFS.open(fastConnectFile, "r");
+    if (!file) {
+        return false;
+    }
+    size_t read = file.read(reinterpret_cast<uint8_t*>(&fastConnectRecord), sizeof(fastConnectRecord));
+    file.close();
+
+    fastConnectValid = read == sizeof(fastConnectRecord)
+            && fastConnectRecord.magic == fastConnectMagic
+            && fastConnectRecord.version == fastConnectVersion
+            && fastConnectRecord.checksum == fastConnectChecksum(fastConnectRecord);
+    return fastConnectValid;
+}
+
+// seconds since the epoch, 0 until SNTP or the RTC set the clock
+uint32_t clockSeconds()
+{
+    time_t now = time(nullptr);
+    return now > 1600000000 ? static_cast<uint32_t>(now) : 0;
+}
+
+uint32_t dhcpLeaseSeconds()
+{
+    struct dhcp* dhcp = netif_default ? netif_dhcp_data(netif_default) : nullptr;
+    return dhcp ? dhcp->offered_t0_lease : 0;
+}
+
+// a cached address is used within the first half of its lease only: the
+// station never renews it, and the DHCP server may hand it out once it ran out
+bool fastConnectLeaseValid()
+{
+    uint32_t usable = fastConnectRecord.leaseSeconds / 2;
+    if (fastConnectLeaseTimed) {
+        return (millis() - fastConnectLeaseAt) / 1000 < usable;
+    }
+    uint32_t now = clockSeconds();
+    return now && fastConnectRecord.leaseStart && now - fastConnectRecord.leaseStart < usable;
+}
+
+void saveFastConnect()
+{
+    FastConnectRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = fastConnectMagic;
+    record.version = fastConnectVersion;
+    record.channel = WiFi.channel();
+    memcpy(record.bssid, WiFi.BSSID(), sizeof(record.bssid));
+    char ssid[33];
+    record.ssidHash = ssidHash(stationSsid(ssid));
+    record.ip = static_cast<uint32_t>(WiFi.localIP());
+    record.gateway = static_cast<uint32_t>(WiFi.gatewayIP());
+    record.subnet = static_cast<uint32_t>(WiFi.subnetMask());
+    record.dns1 = static_cast<uint32_t>(WiFi.dnsIP(0));
+    record.dns2 = static_cast<uint32_t>(WiFi.dnsIP(1));
+
+    // a connect on the cached address keeps its lease, a new lease is written
+    // once the stored one is past half its time, to spare the flash
+    bool sameLease = loadFastConnect() && record.ip == fastConnectRecord.ip
+            && (fastConnectCachedIp || fastConnectLeaseValid());
+    if (sameLease) {
+        record.leaseSeconds = fastConnectRecord.leaseSeconds;
+        record.leaseStart = fastConnectRecord.leaseStart;
+    } else {
+        record.leaseSeconds = dhcpLeaseSeconds();
+        record.leaseStart = clockSeconds();
+        fastConnectLeaseTimed = true;
+        fastConnectLeaseAt = millis();
+    }
+    record.checksum = fastConnectChecksum(record);
+
+    // avoid wearing flash when nothing changed since the last connection
+    if (loadFastConnect() && memcmp(&record, &fastConnectRecord, sizeof(record)) == 0) {
+        return;
+    }
+
+    File file = SPIFFS.open(fastConnectFile, "w");
+    if (!file) {
+        WM_LOGE("Error saving fast connect record");
+        return;
+    }
+    size_t written = file.write(reinterpret_cast<const uint8_t*>(&record), sizeof(record));
+    file.close();
+
+    fastConnectRecord = record;
+    fastConnectValid = written == sizeof(record);
+}
+
+void clearFastConnectRecord()
+{
+    fastConnectLoaded = true;
+    fastConnectValid = false;
+    fastConnectLeaseTimed = false;
+    SPIFFS.remove(fastConnectFile);
+}
+
+bool canFastConnect()
+{
+    return fastConnectEnabled && !fastConnectSkip && loadFastConnect();
+}
+
+void disconnectStation()
+{
+    if (WiFi.status() == WL_CONNECTED
+            || (associated && currentConnectState == ESPReactWifiManager::ConnectState::AwaitingIp)) {
+        selfDisconnectPending = true;
+    }
+#if defined(ESP8266)
+    //trying to fix connection in progress hanging
+    ETS_UART_INTR_DISABLE();
+    wifi_station_disconnect();
+    ETS_UART_INTR_ENABLE();
+#else
+    WiFi.disconnect(false);
+#endif
+}
+
+int str2mac(const char* mac, uint8_t* values){
+   if (6 == sscanf(mac, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &values[0], &values[1], &values[2], &values[3], &values[4], &values[5])) {
+       return 1;
+   } else {
+       return 0;
+   }
+}
+
+// Known networks live in a small binary file: header, length-prefixed
+// versioned records and an FNV-1a trailer over everything before it.
+// Only the ranking data is kept in RAM, credentials are read on selection.
+struct StoredNetwork {
+    StateString<32> ssid;
+    StateString<64> password;
+    StateString<64> login;
+    StateString<64> identity;
+    uint8_t bssid[6];
+    uint8_t successes;
+    uint32_t sequence;
+    StationOptions options; // record version 2
+};
+
+struct KnownNetwork {
+    uint32_t ssidHash;
+    uint32_t sequence;
+    uint8_t successes;
+    uint8_t failures; // since the last success, not persisted
+};
+
+const uint32_t networkStoreMagic = 0x57464e31; // "WFN1"
+const uint8_t networkStoreVersion = 1;
+const uint8_t networkRecordVersion = 2;
+const uint8_t networkRecordMinVersion = 1;
+const size_t networkFieldsSize = 6 + 1 + 4;
+const size_t networkOptionsSize = 1 + 4 * 4;
+const char networkStoreFile[] = "/wifi.nets";
+const uint8_t networkSuccessLimit = 15;
+// success counts alone are written at most this often, see recordNetworkSuccess()
+const uint32_t networkWriteInterval = 3600000;
+
+KnownNetwork knownNetworks[ESPREACT_WIFI_MAX_NETWORKS];
+uint8_t knownNetworkCount = 0;
+bool knownNetworksLoaded = false;
+// store entry used by the running connect, -1 for explicit station options
+int8_t currentNetwork = -1;
+// store entry whose credentials are in connectSsid and friends, reconnects
+// to it do not read the store again
+int8_t loadedNetwork = -1;
+// tried first on the next selection, set when a network is saved from the portal
+int8_t preferredNetwork = -1;
+bool staOptionsSet = false;
+// knownNetworks holds success counts not written to the store yet
+bool networkSuccessesPending = false;
+uint32_t networksWrittenAt = 0;
+
+// the whole store for one read-modify-write. With inline strings it is too
+// big for the stack, store operations then take turns on one static copy.
+#if ESPREACT_STATIC_MEMORY
+StoredNetwork networkScratch[ESPREACT_WIFI_MAX_NETWORKS];
+#define WM_NETWORK_STORE_COPY(name) StoredNetwork* name = networkScratch
+#else
+#define WM_NETWORK_STORE_COPY(name) StoredNetwork name[ESPREACT_WIFI_MAX_NETWORKS]
+#endif
+
+class StoreReader
+{
+public:
+    explicit StoreReader(File& file) : m_file(file) {}
+
+    bool read(void* data, size_t length)
+    {
+        if (m_file.read(static_cast<uint8_t*>(data), length) != length) {
+            return false;
+        }
+        m_hash = fnv1a(static_cast<const uint8_t*>(data), length, m_hash);
+        return true;
+    }
+
+    template<typename T>
+    bool readString(T& value, size_t& remaining)
+    {
+        uint8_t length = 0;
+        char buffer[65];
+        if (remaining < 1 || !read(&length, 1) || length >= sizeof(buffer) || remaining < 1u + length
+                || !read(buffer, length)) {
+            return false;
+        }
+        buffer[length] = 0;
+        value = buffer;
+        remaining -= 1 + length;
+        return true;
+    }
+
+    bool skip(size_t length)
+    {
+        uint8_t buffer[16];
+        while (length > 0) {
+            size_t chunk = std::min(length, sizeof(buffer));
+            if (!read(buffer, chunk)) {
+                return false;
+            }
+            length -= chunk;
+        }
+        return true;
+    }
+
+    uint32_t hash() const { return m_hash; }
+
+private:
+    File& m_file;
+    uint32_t m_hash = 2166136261u;
+};
+
+class StoreWriter
+{
+public:
+    explicit StoreWriter(File& file) : m_file(file) {}
+
+    void write(const void* data, size_t length)
+    {
+        m_ok = m_ok && m_file.write(static_cast<const uint8_t*>(data), length) == length;
+        m_hash = fnv1a(static_cast<const uint8_t*>(data), length, m_hash);
+    }
+
+    template<typename T>
+    void writeString(const T& value)
+    {
+        uint8_t length = value.length();
+        write(&length, 1);
+        write(value.c_str(), length);
+    }
+
+    bool finish()
+    {
+        uint32_t hash = m_hash;
+        write(&hash, sizeof(hash));
+        return m_ok;
+    }
+
+private:
+    File& m_file;
+    uint32_t m_hash = 2166136261u;
+    bool m_ok = true;
+};
+
+uint16_t storedNetworkSize(const StoredNetwork& network)
+{
+    return 4 + network.ssid.length() + network.password.length() + network.login.length()
+            + network.identity.length() + networkFieldsSize + networkOptionsSize;
+}
+
+bool readOptions(StoreReader& reader, StationOptions& options)
+{
+    return reader.read(&options.channel, sizeof(options.channel))
+            && reader.read(&options.ip, sizeof(options.ip))
+            && reader.read(&options.gateway, sizeof(options.gateway))
+            && reader.read(&options.subnet, sizeof(options.subnet))
+            && reader.read(&options.dns, sizeof(options.dns));
+}
+
+void writeOptions(StoreWriter& writer, const StationOptions& options)
+{
+    writer.write(&options.channel, sizeof(options.channel));
+    writer.write(&options.ip, sizeof(options.ip));
+    writer.write(&options.gateway, sizeof(options.gateway));
+    writer.write(&options.subnet, sizeof(options.subnet));
+    writer.write(&options.dns, sizeof(options.dns));
+}
+
+// reads the whole store, records written by newer versions keep their known fields
+bool readNetworks(StoredNetwork* networks, uint8_t& count)
+{
+    count = 0;
+    File file = SPIFFS.open(networkStoreFile, "r");
+    if (!file) {
+        return false;
+    }
+
+    StoreReader reader(file);
+    uint32_t magic = 0;
+    uint8_t version = 0;
+    uint8_t stored = 0;
+    bool ok = reader.read(&magic, sizeof(magic))
+            && magic == networkStoreMagic
+            && reader.read(&version, sizeof(version))
+            && version == networkStoreVersion
+            && reader.read(&stored, sizeof(stored));
+
+    for (uint8_t i = 0; ok && i < stored; ++i) {
+        uint8_t recordVersion = 0;
+        uint16_t length = 0;
+        ok = reader.read(&recordVersion, sizeof(recordVersion))
+                && reader.read(&length, sizeof(length));
+        if (!ok) {
+            break;
+        }
+        size_t remaining = length;
+        // entries beyond this build's capacity are read to verify the checksum only
+        StoredNetwork spare;
+        StoredNetwork& network = i < ESPREACT_WIFI_MAX_NETWORKS ? networks[i] : spare;
+        ok = recordVersion >= networkRecordMinVersion
+                && reader.readString(network.ssid, remaining)
+                && reader.readString(network.password, remaining)
+                && reader.readString(network.login, remaining)
+                && reader.readString(network.identity, remaining)
+                && remaining >= networkFieldsSize
+                && reader.read(network.bssid, sizeof(network.bssid))
+                && reader.read(&network.successes, sizeof(network.successes))
+                && reader.read(&network.sequence, sizeof(network.sequence));
+        remaining -= ok ? networkFieldsSize : 0;
+        // version 1 records predate channel and static addressing
+        network.options = StationOptions();
+        if (ok && recordVersion >= 2) {
+            ok = remaining >= networkOptionsSize && readOptions(reader, network.options);
+            remaining -= ok ? networkOptionsSize : 0;
+        }
+        ok = ok && reader.skip(remaining);
+        if (ok && i < ESPREACT_WIFI_MAX_NETWORKS) {
+            ++count;
+        }
+    }
+
+    uint32_t expected = reader.hash();
+    uint32_t checksum = 0;
+    ok = ok && file.read(reinterpret_cast<uint8_t*>(&checksum), sizeof(checksum)) == sizeof(checksum)
+            && checksum == expected;
+    file.close();
+
+    if (!ok) {
+        WM_LOGW("Ignoring damaged network store");
+        count = 0;
+    }
+    return ok;
+}
+
+void indexNetworks(const StoredNetwork* networks, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; ++i) {
+        knownNetworks[i].ssidHash = ssidHash(networks[i].ssid.c_str());
+        knownNetworks[i].sequence = networks[i].sequence;
+        knownNetworks[i].successes = networks[i].successes;
+        knownNetworks[i].failures = 0;
+    }
+    knownNetworkCount = count;
+    knownNetworksLoaded = true;
+}
+
+bool writeNetworks(const StoredNetwork* networks, uint8_t count)
+{
+    File file = SPIFFS.open(networkStoreFile, "w");
+    if (!file) {
+        WM_LOGE("Error saving network store");
+        return false;
+    }
+
+    StoreWriter writer(file);
+    uint32_t magic = networkStoreMagic;
+    writer.write(&magic, sizeof(magic));
+    writer.write(&networkStoreVersion, sizeof(networkStoreVersion));
+    writer.write(&count, sizeof(count));
+    for (uint8_t i = 0; i < count; ++i) {
+        const StoredNetwork& network = networks[i];
+        uint16_t length = storedNetworkSize(network);
+        writer.write(&networkRecordVersion, sizeof(networkRecordVersion));
+        writer.write(&length, sizeof(length));
+        writer.writeString(network.ssid);
+        writer.writeString(network.password);
+        writer.writeString(network.login);
+        writer.writeString(network.identity);
+        writer.write(network.bssid, sizeof(network.bssid));
+        writer.write(&network.successes, sizeof(network.successes));
+        writer.write(&network.sequence, sizeof(network.sequence));
+        writeOptions(writer, network.options);
+    }
+    bool ok = writer.finish();
+    file.close();
+    loadedNetwork = -1;
+    if (ok) {
+        networkSuccessesPending = false;
+        networksWrittenAt = millis();
+    }
+
+    // failure counts are not stored, they follow their network by SSID hash
+    // since removeNetwork() moves the entries after the removed one
+    KnownNetwork previous[ESPREACT_WIFI_MAX_NETWORKS];
+    uint8_t previousCount = knownNetworkCount;
+    memcpy(previous, knownNetworks, sizeof(previous));
+    indexNetworks(networks, count);
+    for (uint8_t i = 0; i < count; ++i) {
+        for (uint8_t j = 0; j < previousCount; ++j) {
+            if (previous[j].ssidHash == knownNetworks[i].ssidHash) {
+                knownNetworks[i].failures = previous[j].failures;
+            }
+        }
+    }
+    return ok;
+}
+
+int8_t findNetwork(const StoredNetwork* networks, uint8_t count, const char* ssid)
+{
+    for (uint8_t i = 0; i < count; ++i) {
+        if (strcmp(networks[i].ssid.c_str(), ssid) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int8_t findKnownNetwork(uint32_t hash)
+{
+    for (uint8_t i = 0; i < knownNetworkCount; ++i) {
+        if (knownNetworks[i].ssidHash == hash) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// success counts of knownNetworks that are not written yet, into a store copy
+// about to be rewritten
+void mergeKnownSuccesses(StoredNetwork* networks, uint8_t count)
+{
+    if (!networkSuccessesPending) {
+        return;
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+        int8_t known = findKnownNetwork(ssidHash(networks[i].ssid.c_str()));
+        if (known >= 0) {
+            networks[i].successes = knownNetworks[known].successes;
+        }
+    }
+}
+
+uint32_t lastNetworkSequence()
+{
+    uint32_t sequence = 0;
+    for (uint8_t i = 0; i < knownNetworkCount; ++i) {
+        sequence = std::max(sequence, knownNetworks[i].sequence);
+    }
+    return sequence;
+}
+
+void loadKnownNetworks()
+{
+    if (knownNetworksLoaded) {
+        return;
+    }
+    WM_NETWORK_STORE_COPY(networks);
+    uint8_t count = 0;
+    readNetworks(networks, count);
+    indexNetworks(networks, count);
+}
+
+// at most limit characters of value, the rest does not fit the SDK either
+template<typename T>
+void assignBounded(T& out, const char* value, size_t limit)
+{
+    char buffer[65];
+    size_t length = std::min(strlen(value), std::min(limit, sizeof(buffer) - 1));
+    memcpy(buffer, value, length);
+    buffer[length] = 0;
+    out = buffer;
+}
+
+int8_t storeNetwork(const char* ssid, const char* password, const char* login,
+                    const char* bssid, const char* identity,
+                    const StationOptions& options = StationOptions())
+{
+    // before the copy is filled, it may share the buffer with this one
+    loadKnownNetworks();
+    WM_NETWORK_STORE_COPY(networks);
+    uint8_t count = 0;
+    readNetworks(networks, count);
+    mergeKnownSuccesses(networks, count);
+
+    int8_t index = findNetwork(networks, count, ssid);
+    if (index < 0 && count < ESPREACT_WIFI_MAX_NETWORKS) {
+        index = count++;
+    } else if (index < 0) {
+        // full, replace the network used longest ago
+        index = 0;
+        for (uint8_t i = 1; i < count; ++i) {
+            if (networks[i].sequence < networks[index].sequence) {
+                index = i;
+            }
+        }
+    }
+
+    StoredNetwork& network = networks[index];
+    assignBounded(network.ssid, ssid, 32);
+    assignBounded(network.password, password, 64);
+    assignBounded(network.login, login, 64);
+    assignBounded(network.identity, identity, 64);
+    memset(network.bssid, 0, sizeof(network.bssid));
+    if (bssid[0]) {
+        str2mac(bssid, network.bssid);
+    }
+    network.successes = 0;
+    network.sequence = lastNetworkSequence() + 1;
+    network.options = options;
+
+    if (!writeNetworks(networks, count)) {
+        return -1;
+    }
+    knownNetworks[index].failures = 0;
+    return index;
+}
+
+// latest scan RSSI plus history; networks not seen in the scan (hidden, or
+// no scan yet) still rank so the most recently used one gets tried
+int16_t networkScore(uint8_t index)
+{
+    const KnownNetwork& known = knownNetworks[index];
+    int16_t rssi = -100;
+    const ESPReactWifiManager::WifiRecord* pool = wifiPools[publishedPool];
+    for (size_t i = 0; i < wifiPoolSize[publishedPool]; ++i) {
+        if (fnv1a(reinterpret_cast<const uint8_t*>(pool[i].ssid), strlen(pool[i].ssid)) == known.ssidHash) {
+            rssi = pool[i].rssi;
+            break;
+        }
+    }
+    return rssi + 3 * known.successes - 10 * known.failures;
+}
+
+bool selectStoredNetwork()
+{
+    loadKnownNetworks();
+    if (knownNetworkCount == 0) {
+        return false;
+    }
+
+    int8_t best = preferredNetwork;
+    preferredNetwork = -1;
+    if (best < 0 || best >= knownNetworkCount) {
+        best = 0;
+        int16_t bestScore = networkScore(0);
+        for (uint8_t i = 1; i < knownNetworkCount; ++i) {
+            int16_t score = networkScore(i);
+            if (score > bestScore
+                    || (score == bestScore && knownNetworks[i].sequence > knownNetworks[best].sequence)) {
+                best = i;
+                bestScore = score;
+            }
+        }
+    }
+
+    currentNetwork = best;
+    if (best == loadedNetwork) {
+        WM_LOGI("Selected known network %s again, score %d", connectSsid.c_str(), networkScore(best));
+        return true;
+    }
+
+    WM_NETWORK_STORE_COPY(networks);
+    uint8_t count = 0;
+    if (!readNetworks(networks, count) || best >= count) {
+        currentNetwork = -1;
+        return false;
+    }
+
+    const StoredNetwork& network = networks[best];
+    connectSsid = network.ssid;
+    connectPassword = network.password;
+    connectLogin = network.login;
+    connectIdentity = network.identity;
+    connectBssid = "";
+    connectOptions = network.options;
+    static const uint8_t noBssid[6] = { 0 };
+    if (memcmp(network.bssid, noBssid, sizeof(noBssid)) != 0) {
+        char bssid[18];
+        formatMac(bssid, network.bssid);
+        connectBssid = bssid;
+    }
+    loadedNetwork = best;
+    WM_LOGI("Selected known network %s, score %d", connectSsid.c_str(), networkScore(best));
+    return true;
+}
+
+void recordNetworkFailure()
+{
+    if (currentNetwork >= 0 && currentNetwork < knownNetworkCount
+            && knownNetworks[currentNetwork].failures < UINT8_MAX) {
+        ++knownNetworks[currentNetwork].failures;
+    }
+}
+
+void recordNetworkSuccess()
+{
+    loadKnownNetworks();
+    char ssid[33];
+    int8_t index = findKnownNetwork(ssidHash(stationSsid(ssid)));
+    if (index < 0) {
+        return;
+    }
+    KnownNetwork& known = knownNetworks[index];
+    known.failures = 0;
+    if (known.successes < networkSuccessLimit) {
+        ++known.successes;
+        networkSuccessesPending = true;
+    }
+
+    // the ranking in RAM is current at once. The store is rewritten when
+    // another network took over, reconnects to the same one only add to
+    // its count and reach flash at most every networkWriteInterval.
+    uint32_t last = lastNetworkSequence();
+    bool switched = known.sequence != last;
+    if (!switched && (!networkSuccessesPending || millis() - networksWrittenAt < networkWriteInterval)) {
+        return;
+    }
+
+    WM_NETWORK_STORE_COPY(networks);
+    uint8_t count = 0;
+    if (!readNetworks(networks, count) || index >= count) {
+        return;
+    }
+    mergeKnownSuccesses(networks, count);
+    if (switched) {
+        networks[index].sequence = last + 1;
+    }
+    writeNetworks(networks, count);
+}
+
+// JSON bodies above this are refused before parsing
+const size_t maxSaveBody = 1024;
+
+bool parseAddress(const char* text, uint32_t& address)
+{
+    unsigned int octets[4];
+    char tail;
+    address = 0;
+    if (!text[0]) {
+        return true;
+    }
+    if (sscanf(text, "%u.%u.%u.%u%c", &octets[0], &octets[1], &octets[2], &octets[3], &tail) != 4
+            || octets[0] > 255 || octets[1] > 255 || octets[2] > 255 || octets[3] > 255) {
+        return false;
+    }
+    address = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+    return true;
+}
+
+// checks a parsed form, returns a PROGMEM error or nullptr
+const char* validateSave(const WifiSaveForm& form, StationOptions& options)
+{
+    options = StationOptions();
+    if (!form.ssid[0]) {
+        return PSTR("Wrong request. No ssid");
+    }
+    uint8_t mac[6];
+    if (form.bssid[0] && !str2mac(form.bssid, mac)) {
+        return PSTR("invalid bssid");
+    }
+    if (form.channel[0]) {
+        char* end = nullptr;
+        unsigned long channel = strtoul(form.channel, &end, 10);
+        if (*end || channel < 1 || channel > 14) {
+            return PSTR("invalid channel");
+        }
+        options.channel = channel;
+    }
+    if (!parseAddress(form.ip, options.ip)
+            || !parseAddress(form.gateway, options.gateway)
+            || !parseAddress(form.subnet, options.subnet)
+            || !parseAddress(form.dns, options.dns)) {
+        return PSTR("invalid address");
+    }
+    if (options.ip && !options.gateway) {
+        return PSTR("static ip needs a gateway");
+    }
+    if (options.ip && !options.subnet) {
+        options.subnet = IPAddress(255, 255, 255, 0);
+    }
+    if (!options.ip) {
+        options.gateway = options.subnet = options.dns = 0;
+    }
+    return nullptr;
+}
+
+// saves are parsed in the web server context and applied in loop()
+struct PendingSave {
+    WifiSaveForm form;
+    StationOptions options;
+};
+SpscQueue<PendingSave, 1> pendingSaves;
+
+// parser and result of one save in request->_tempObject, which the server
+// frees with the request, also when the client drops mid-body
+struct SaveRequest {
+    WifiSaveParser parser;
+    PendingSave save;
+};
+static_assert(std::is_trivially_destructible<SaveRequest>::value, "released with free() by the server");
+
+SaveRequest* beginSaveRequest(AsyncWebServerRequest* request, bool json)
+{
+    SaveRequest* state = static_cast<SaveRequest*>(request->_tempObject);
+    if (!state) {
+        void* memory = malloc(sizeof(SaveRequest));
+        if (!memory) {
+            return nullptr;
+        }
+        state = new (memory) SaveRequest();
+        request->_tempObject = state;
+    }
+    state->parser.begin(&state->save.form, json);
+    return state;
+}
+
+class WifiSaveHandler : public AsyncWebHandler
+{
+public:
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_POST && request->url() == F("/wifiSave");
+    }
+
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                    size_t index, size_t total) override
+    {
+        SaveRequest* state = static_cast<SaveRequest*>(request->_tempObject);
+        if (index == 0) {
+            state = beginSaveRequest(request, true);
+            if (!state) {
+                return;
+            }
+            if (!isJson(request)) {
+                state->parser.fail(PSTR("unsupported content type"));
+            } else if (total > maxSaveBody) {
+                state->parser.fail(PSTR("body too large"));
+            }
+        }
+        if (state) {
+            state->parser.feed(data, len);
+        }
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        WM_LOGD("wifiSave request");
+
+        SaveRequest* state = static_cast<SaveRequest*>(request->_tempObject);
+        const char* error = nullptr;
+        int code = 400;
+        if (isJson(request)) {
+            if (state) {
+                error = state->parser.finish();
+            } else if (request->contentLength() > 0) {
+                error = PSTR("out of memory");
+                code = 503;
+            } else {
+                error = PSTR("malformed JSON");
+            }
+        } else if (!(state = beginSaveRequest(request, false))) {
+            error = PSTR("out of memory");
+            code = 503;
+        } else {
+            for (size_t i = 0; i < request->params(); ++i) {
+                AsyncWebParameter* param = request->getParam(i);
+                if (!param->isFile()) {
+                    state->parser.assign(param->name().c_str(), param->value().c_str(), param->value().length());
+                }
+            }
+            error = state->parser.finish();
+        }
+
+        if (!error) {
+            error = validateSave(state->save.form, state->save.options);
+        }
+        if (!error && !pendingSaves.push(state->save)) {
+            error = PSTR("another save is in progress");
+            code = 503;
+        }
+        if (!error) {
+            wakeTask();
+        }
+        if (error) {
+            WM_LOGW("wifiSave rejected: %s", String(FPSTR(error)).c_str());
+            request->send(code, F("text/plain"), FPSTR(error));
+            return;
+        }
+
+        // the outcome is pushed over /wifiEvents
+        char message[sizeof(state->save.form.ssid) + 16];
+        snprintf_P(message, sizeof(message), PSTR("Connecting to: %s"), state->save.form.ssid);
+        request->send(200, F("text/html"), message);
+    }
+
+    bool isRequestHandlerTrivial() override { return false; }
+
+private:
+    static bool isJson(AsyncWebServerRequest* request)
+    {
+        return request->contentType().startsWith(F("application/json"));
+    }
+};
+
+void applyPendingSave(const PendingSave& save)
+{
+    const WifiSaveForm& form = save.form;
+    WM_LOGI("Saving network %s", form.ssid);
+
+    // remembered with the other known networks and tried first
+    int8_t index = storeNetwork(form.ssid, form.password, form.login, form.bssid, "", save.options);
+    if (index >= 0) {
+        instance->setStaOptions("");
+        preferredNetwork = index;
+    } else {
+        instance->setStaOptions(form.ssid, form.password, form.login, form.bssid);
+        connectOptions = save.options;
+    }
+    instance->connect();
+}
+
+void notFoundHandler(AsyncWebServerRequest* request)
+{
+    if (request->url().endsWith(F(".map"))) {
+        request->send(404);
+        return;
+    }
+
+    WM_LOGD("Not found: %s request: %s local: %s", request->url().c_str(),
+            request->client()->localIP().toString().c_str(),
+            WiFi.localIP().toString().c_str());
+
+    bool isLocal = WiFi.localIP() == request->client()->localIP();
+
+    if (!isLocal && captiveCallback && captiveCallback(request)) {
+        return;
+    }
+
+    if (!isLocal) {
+        if (captivePortalUrl[0] && request->client()->localIP() == apIP) {
+            WM_LOGD("Request %s redirected to captive portal", request->url().c_str());
+            request->redirect(captivePortalUrl);
+            return;
+        }
+        String redirect = String(F("http://"))
+                + request->client()->localIP().toString()
+                + String(F("/wifi.html"));
+        WM_LOGD("Request %s redirected to captive portal: %s", request->url().c_str(), redirect.c_str());
+
+        request->redirect(redirect);
+        return;
+    }
+
+    // client-side routes of the portal all load its index page
+    if (request->method() == HTTP_GET && sendDefaultPortalAsset(request)) {
+        return;
+    }
+
+    if (notFoundCallback) {
+        notFoundCallback(request);
+    }
+}
+
+bool isCaptiveProbe(const String& url)
+{
+    for (size_t i = 0; i < sizeof(captiveProbes) / sizeof(captiveProbes[0]); ++i) {
+        if (strcmp_P(url.c_str(), captiveProbes[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Redirects OS connectivity probes to the portal with the URL cached by
+// setupAP(), skipping the logging and string building of notFoundHandler.
+class CaptiveProbeHandler : public AsyncWebHandler
+{
+public:
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_GET
+                && captivePortalUrl[0]
+                && request->client()->localIP() == apIP
+                && isCaptiveProbe(request->url());
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        ++captiveProbeCount;
+        if (captiveCallback && captiveCallback(request)) {
+            return;
+        }
+        request->redirect(captivePortalUrl);
+    }
+};
+
+const __FlashStringHelper* connectStateName(ESPReactWifiManager::ConnectState state)
+{
+    switch (state) {
+    case ESPReactWifiManager::ConnectState::Idle: return F("Idle");
+    case ESPReactWifiManager::ConnectState::Disconnecting: return F("Disconnecting");
+    case ESPReactWifiManager::ConnectState::SwitchingMode: return F("SwitchingMode");
+    case ESPReactWifiManager::ConnectState::Configuring: return F("Configuring");
+    case ESPReactWifiManager::ConnectState::Beginning: return F("Beginning");
+    case ESPReactWifiManager::ConnectState::AwaitingIp: return F("AwaitingIp");
+    case ESPReactWifiManager::ConnectState::Connected: return F("Connected");
+    case ESPReactWifiManager::ConnectState::Failed: return F("Failed");
+    }
+    return F("");
+}
+
+void sendConnectProgress(AsyncEventSourceClient* client)
+{
+    char state[16];
+    strncpy_P(state, reinterpret_cast<PGM_P>(connectStateName(currentConnectState)), sizeof(state) - 1);
+    state[sizeof(state) - 1] = 0;
+    char json[32];
+    snprintf_P(json, sizeof(json), PSTR("{\"state\":\"%s\"}"), state);
+    if (client) {
+        client->send(json, "progress");
+    } else {
+        eventSource->send(json, "progress");
+    }
+}
+
+void sendConnected(AsyncEventSourceClient* client)
+{
+    char ssid[33];
+    char quoted[2 + 6 * 32 + 1];
+    char bssid[18];
+    char ip[16];
+    char json[sizeof(quoted) + 96];
+    snprintf_P(json, sizeof(json), PSTR("{\"ssid\":%s,\"bssid\":\"%s\",\"ip\":\"%s\",\"rssi\":%d,\"channel\":%d}"),
+               writeJsonString(quoted, sizeof(quoted), stationSsid(ssid)), formatMac(bssid, WiFi.BSSID()),
+               formatIp(ip, WiFi.localIP()), static_cast<int>(WiFi.RSSI()), static_cast<int>(WiFi.channel()));
+    if (client) {
+        client->send(json, "connected");
+    } else {
+        eventSource->send(json, "connected");
+    }
+}
+
+void pushConnectFailure(const __FlashStringHelper* reason, uint8_t code = 0)
+{
+    if (!hasEventClients()) {
+        return;
+    }
+    char text[24];
+    strncpy_P(text, reinterpret_cast<PGM_P>(reason), sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+    char json[64];
+    if (code) {
+        snprintf_P(json, sizeof(json), PSTR("{\"reason\":\"%s\",\"code\":%u}"), text, code);
+    } else {
+        snprintf_P(json, sizeof(json), PSTR("{\"reason\":\"%s\"}"), text);
+    }
+    eventSource->send(json, "failed");
+}
+
+// what a station disconnect says about the next attempt: a password the AP
+// rejected or a network that is not on the air does not get better by retrying
+enum class DisconnectKind : uint8_t {
+    Transient,
+    BadCredentials,
+    NotFound
+};
+
+// not an SDK reason, those start at 1
+const uint8_t timeoutReason = 0;
+
+#if defined(ESP8266)
+#define WM_DISCONNECT_REASON(name) WIFI_DISCONNECT_REASON_##name
+#else
+#define WM_DISCONNECT_REASON(name) WIFI_REASON_##name
+#endif
+
+DisconnectKind classifyDisconnect(uint8_t reason)
+{
+    switch (reason) {
+    case WM_DISCONNECT_REASON(AUTH_FAIL):
+    // a WPA2 handshake that does not complete is how a wrong PSK shows up
+    case WM_DISCONNECT_REASON(4WAY_HANDSHAKE_TIMEOUT):
+    case WM_DISCONNECT_REASON(HANDSHAKE_TIMEOUT):
+        return DisconnectKind::BadCredentials;
+    case WM_DISCONNECT_REASON(NO_AP_FOUND):
+        return DisconnectKind::NotFound;
+    default:
+        return DisconnectKind::Transient;
+    }
+}
+
+// the manager's own disconnects, see selfDisconnectPending
+bool isOwnDisconnect(uint8_t reason)
+{
+    return reason == WM_DISCONNECT_REASON(ASSOC_LEAVE);
+}
+
+#undef WM_DISCONNECT_REASON
+
+const __FlashStringHelper* failureText(DisconnectKind kind, uint8_t reason, bool exhausted)
+{
+    switch (kind) {
+    case DisconnectKind::BadCredentials:
+        return F("wrong password");
+    case DisconnectKind::NotFound:
+        return F("network not found");
+    default:
+        break;
+    }
+    if (exhausted) {
+        return F("retries exhausted");
+    }
+    return reason == timeoutReason ? F("timeout") : F("attempt failed");
+}
 
-namespace {
+uint32_t connectStepDelay(ESPReactWifiManager::ConnectState state)
+{
+    // settle delays are skipped when cached channel and BSSID are going to be
+    // used, and when roaming as the station stays in STA mode
+    bool settle = !canFastConnect() && !roamPending;
+
+    switch (state) {
+    case ESPReactWifiManager::ConnectState::Disconnecting:
+        return settle ? disconnectSettleTime : 0;
+    case ESPReactWifiManager::ConnectState::SwitchingMode:
+        return settle ? modeSwitchSettleTime : 0;
+    case ESPReactWifiManager::ConnectState::Configuring:
+    case ESPReactWifiManager::ConnectState::Beginning:
+        return 0;
+    case ESPReactWifiManager::ConnectState::AwaitingIp:
+        // the got-IP and disconnect events end this state, the timer bounds
+        // the association, recordAssociated() restarts it for DHCP
+        return fastConnectAttempt ? fastConnectTimeout : associateTimeout;
+    default:
+        return TimerWheel<TimerCount>::Never;
+    }
+}
 
-ESPReactWifiManager *instance = nullptr;
+void setConnectState(ESPReactWifiManager::ConnectState state)
+{
+    currentConnectState = state;
 
-bool isConnecting = false;
-bool fallbackToAp = true;
+    // each state is left by stepConnect() once its delay has passed
+    uint32_t delay = connectStepDelay(state);
+    if (delay == TimerWheel<TimerCount>::Never) {
+        timers.cancel(ConnectStepTimer);
+    } else {
+        startTimer(ConnectStepTimer, delay);
+    }
 
-String connectSsid;
-String connectPassword;
-String connectLogin;
-String connectBssid;
+    if (hasEventClients()) {
+        sendConnectProgress(nullptr);
+    }
 
-String connectApName;
-String connectApPassword;
+    if (connectProgressCallback) {
+        connectProgressCallback(state);
+    }
+}
 
-uint32_t shouldScan = 0;
-uint32_t shouldConnect = 0;
+bool isConnectInProgress()
+{
+    switch (currentConnectState) {
+    case ESPReactWifiManager::ConnectState::Disconnecting:
+    case ESPReactWifiManager::ConnectState::SwitchingMode:
+    case ESPReactWifiManager::ConnectState::Configuring:
+    case ESPReactWifiManager::ConnectState::Beginning:
+    case ESPReactWifiManager::ConnectState::AwaitingIp:
+        return true;
+    default:
+        return false;
+    }
+}
 
-uint32_t reconnectInterval = 60 * 1000;
+bool configureStation()
+{
+    if (!wifiHostname.isEmpty()) {
+#if defined(ESP8266)
+        WiFi.hostname(wifiHostname.c_str());
+#else
+        WiFi.setHostname(wifiHostname.c_str());
+#endif
+    }
 
-DNSServer* dnsServer = nullptr;
-void (*finishedCallback)(bool) = nullptr;
-void (*notFoundCallback)(AsyncWebServerRequest*) = nullptr;
-bool (*captiveCallback)(AsyncWebServerRequest*) = nullptr;
+    if (roamPending) {
+        // same network, beginStation() pins the roam target
+    } else if (staOptionsSet) {
+        currentNetwork = -1;
+    } else if (!selectStoredNetwork()) {
+        sta_config_t sta_conf;
+#if defined(ESP32)
+        wifi_config_t current_conf;
+        esp_wifi_get_config(WIFI_IF_STA, &current_conf);
+        sta_conf = current_conf.sta;
+#else
+        wifi_station_get_config_default(&sta_conf);
+#endif
+        char ssid[33];
+        memcpy(ssid, sta_conf.ssid, 32);
+        ssid[32] = 0;
+        connectSsid = ssid;
+        loadedNetwork = -1;
 
-String wifiHostname;
+        if (connectSsid.length() == 0) {
+            WM_LOGI("No last saved network");
+            return false;
+        }
 
-std::vector<ESPReactWifiManager::WifiResult> wifiResults;
-int wifiIndex = 0;
+        char savedPassword[65];
+        memcpy(savedPassword, sta_conf.password, 64);
+        savedPassword[64] = 0;
 
-Ticker wifiReconnectTimer;
+        // enterprise credentials were saved as "x:login:password"
+        char* separator = savedPassword[0] == 'x' && savedPassword[1] == ':' ? strchr(savedPassword + 2, ':') : nullptr;
+        if (separator) {
+            connectPassword = separator + 1;
+            *separator = 0;
+            connectLogin = savedPassword + 2;
+        } else {
+            connectPassword = savedPassword;
+        }
+        connectIdentity = "";
+        connectBssid = "";
+        connectOptions = StationOptions();
 
-uint8_t retryCount = 0;
-uint8_t retryLimit = 5;
+        WM_LOGI("Connecting to last saved network");
+        // move it into the network store, the SDK keeps only one
+        currentNetwork = storeNetwork(connectSsid.c_str(), connectPassword.c_str(), connectLogin.c_str(), "", "");
+    }
 
-#if defined(ESP8266)
-WiFiEventHandler wifiConnectHandler;
-WiFiEventHandler wifiDisconnectHandler;
+    if (connectLogin.length() > 0) {
+#if defined(ESP32)
+        esp_wpa2_config_t config = WPA2_CONFIG_INIT_DEFAULT();
+        esp_wifi_sta_wpa2_ent_enable(&config);
+#else
+        wifi_station_set_wpa2_enterprise_auth(1);
 #endif
+        const char* identity = connectIdentity.length() > 0 ? connectIdentity.c_str() : connectLogin.c_str();
+        esp_wifi_sta_wpa2_ent_set_identity((wifi_cred_t*)identity, strlen(identity));
+        esp_wifi_sta_wpa2_ent_set_username((wifi_cred_t*)connectLogin.c_str(), connectLogin.length());
+        esp_wifi_sta_wpa2_ent_set_password((wifi_cred_t*)connectPassword.c_str(), connectPassword.length());
+    }
 
-const float wifiReconnectDelay = 5;
+    return true;
+}
 
-bool signalLess(const ESPReactWifiManager::WifiResult& a,
-                const ESPReactWifiManager::WifiResult& b)
+void beginStation()
 {
-    return a.rssi > b.rssi;
+    // enterprise credentials were set in configureStation(), the SDK still
+    // saves "x:login:password" as the passphrase so configureStation() can
+    // restore them after a reboot
+    const char* passphrase = connectPassword.c_str();
+    char enterprisePassphrase[65];
+    if (connectLogin.length() == 0) {
+        WM_LOGI("Connecting to network: %s", connectSsid.c_str());
+    } else {
+        WM_LOGI("Connecting to secure network: %s", connectSsid.c_str());
+        int length = snprintf_P(enterprisePassphrase, sizeof(enterprisePassphrase), PSTR("x:%s:%s"),
+                                connectLogin.c_str(), connectPassword.c_str());
+        if (length >= 0 && static_cast<size_t>(length) < sizeof(enterprisePassphrase)) {
+            passphrase = enterprisePassphrase;
+        } else {
+            // longer than the SDK field, only the network store keeps them
+            WM_LOGW("Enterprise credentials too long to save in the SDK config");
+            passphrase = nullptr;
+        }
+    }
+    uint8_t mac[6] = { 0 };
+    bool pinned = connectBssid.length() > 0 && str2mac(connectBssid.c_str(), mac);
+    if (roamPending) {
+        memcpy(mac, roamTarget, sizeof(mac));
+        pinned = true;
+    }
+    // the strongest BSSID that answered the connect probe
+    uint8_t probedChannel = 0;
+    if (probeHint && !roamPending) {
+        if (!pinned) {
+            memcpy(mac, probeBest.bssid, sizeof(mac));
+            pinned = true;
+        }
+        probedChannel = probeBest.channel;
+        probeHint = false;
+    }
+
+    fastConnectAttempt = !roamPending && canFastConnect()
+            && fastConnectRecord.ssidHash == ssidHash(connectSsid.c_str())
+            && (!pinned || memcmp(mac, fastConnectRecord.bssid, sizeof(mac)) == 0);
+
+    fastConnectCachedIp = fastConnectAttempt && fastConnectStaticIp && fastConnectLeaseValid();
+    if (!fastConnectCachedIp) {
+        if (connectOptions.ip) {
+            char ip[16];
+            WM_LOGI("Static IP %s", formatIp(ip, IPAddress(connectOptions.ip)));
+            WiFi.config(IPAddress(connectOptions.ip),
+                        IPAddress(connectOptions.gateway),
+                        IPAddress(connectOptions.subnet),
+                        IPAddress(connectOptions.dns ? connectOptions.dns : connectOptions.gateway));
+            staticIpApplied = true;
+        } else if (staticIpApplied) {
+            WiFi.config(IPAddress(), IPAddress(), IPAddress());
+            staticIpApplied = false;
+        }
+    }
+
+    if (fastConnectAttempt) {
+        WM_LOGI("Fast connect on channel %u", fastConnectRecord.channel);
+        if (fastConnectCachedIp) {
+            WiFi.config(IPAddress(fastConnectRecord.ip),
+                        IPAddress(fastConnectRecord.gateway),
+                        IPAddress(fastConnectRecord.subnet),
+                        IPAddress(fastConnectRecord.dns1),
+                        IPAddress(fastConnectRecord.dns2));
+            staticIpApplied = true;
+        } else if (fastConnectStaticIp) {
+            WM_LOGD("Cached lease expired, using DHCP");
+        }
+        WiFi.begin(connectSsid.c_str(), passphrase,
+                   fastConnectRecord.channel, fastConnectRecord.bssid);
+    } else {
+        // a roam target may sit on another channel than the one saved
+        int32_t channel = roamPending ? 0 : connectOptions.channel;
+        if (probedChannel) {
+            channel = probedChannel;
+        }
+        if (pinned) {
+            WM_LOGI("Pin to BSSID: %02X:%02X:%02X:%02X:%02X:%02X",
+                    mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        }
+        if (channel) {
+            WM_LOGI("Channel %d", static_cast<int>(channel));
+        }
+        WiFi.begin(connectSsid.c_str(), passphrase, channel, pinned ? mac : nullptr);
+    }
+
+    connectBeganAt = millis();
+    associated = false;
+    attemptFailed = false;
+    ++stationAttempt;
+    WM_LOGD("Finished connecting");
 }
 
-bool ssidEqual(const ESPReactWifiManager::WifiResult& a,
-               const ESPReactWifiManager::WifiResult& b)
+void fallbackFromFastConnect()
 {
-    return a.ssid == b.ssid;
+    WM_LOGW("Fast connect failed, using full connect");
+
+    fastConnectAttempt = false;
+    fastConnectSkip = true;
+    isConnecting = true;
+
+    if (staticIpApplied) {
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        staticIpApplied = false;
+    }
+    disconnectStation();
+    setConnectState(ESPReactWifiManager::ConnectState::Beginning);
 }
 
-bool ssidLess(const ESPReactWifiManager::WifiResult& a,
-              const ESPReactWifiManager::WifiResult& b)
+void failTimedOutAttempt();
+
+// a directed probe before WiFi.begin() finds hidden networks and gives the
+// channel and BSSID to join; the SDK would sweep every channel itself
+bool startConnectProbe()
 {
-    return a.ssid == b.ssid ? signalLess(a, b) : a.ssid < b.ssid;
-}
+    probeHint = false;
+    if (!connectProbeEnabled || roamPending || connectSsid.length() == 0) {
+        return false;
+    }
+    // cached channel and BSSID are tried first
+    if (canFastConnect() && fastConnectRecord.ssidHash == ssidHash(connectSsid.c_str())) {
+        return false;
+    }
+    if (connectBssid.length() > 0 && connectOptions.channel) {
+        return false;
+    }
 
-int str2mac(const char* mac, uint8_t* values){
-   if (6 == sscanf(mac, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &values[0], &values[1], &values[2], &values[3], &values[4], &values[5])) {
-       return 1;
-   } else {
-       return 0;
-   }
+    // one channel when it is known from the options or the last scan
+    uint8_t channel = connectOptions.channel;
+    const ESPReactWifiManager::WifiRecord* pool = wifiPools[publishedPool];
+    for (size_t i = 0; channel == 0 && i < wifiPoolSize[publishedPool]; ++i) {
+        if (strcmp(pool[i].ssid, connectSsid.c_str()) == 0) {
+            channel = pool[i].channel;
+        }
+    }
+    return startProbe(ProbePurpose::Connect, connectSsid.c_str(), channel, false);
 }
 
-void notFoundHandler(AsyncWebServerRequest* request)
+void finishProbe()
 {
-    if (request->url().endsWith(F(".map"))) {
-        request->send(404);
-        return;
+    ProbePurpose purpose = probePurpose;
+    probePurpose = ProbePurpose::None;
+    if (probeFound) {
+        WM_LOGD("Probe for %s answered on channel %d at %d dBm", probeSsid, probeBest.channel, probeBest.rssi);
+    } else {
+        WM_LOGD("No answer to probe for %s", probeSsid);
     }
 
-    Serial.print(F("Not found: "));
-    Serial.println(request->url());
+    switch (purpose) {
+    case ProbePurpose::Connect:
+        // a connect started meanwhile went on without the probe
+        if (currentConnectState != ESPReactWifiManager::ConnectState::Configuring) {
+            return;
+        }
+        // not found is left to WiFi.begin(), a probe can go unanswered
+        probeHint = probeFound;
+        setConnectState(ESPReactWifiManager::ConnectState::Beginning);
+        break;
+    case ProbePurpose::Roam:
+        finishRoamScan();
+        break;
+    case ProbePurpose::User:
+        if (probeCallback) {
+            probeCallback(probeFound, probeBest);
+        }
+        break;
+    case ProbePurpose::None:
+        break;
+    }
+}
 
-    Serial.print(F("Request: "));
-    Serial.println(request->client()->localIP());
+void stepConnect()
+{
+    switch (currentConnectState) {
+    case ESPReactWifiManager::ConnectState::Disconnecting:
+        WiFi.mode(provisioningConnect ? WIFI_AP_STA : WIFI_STA);
+        setConnectState(ESPReactWifiManager::ConnectState::SwitchingMode);
+        break;
+    case ESPReactWifiManager::ConnectState::SwitchingMode:
+        setConnectState(ESPReactWifiManager::ConnectState::Configuring);
+        break;
+    case ESPReactWifiManager::ConnectState::Configuring:
+        if (configureStation()) {
+            // otherwise finishProbe() moves on
+            if (!startConnectProbe()) {
+                setConnectState(ESPReactWifiManager::ConnectState::Beginning);
+            }
+        } else {
+            isConnecting = false;
+            pushConnectFailure(F("no credentials"));
+            setConnectState(ESPReactWifiManager::ConnectState::Failed);
+            if (apIfNoCredentials) {
+                apIfNoCredentials = false;
+                instance->startAP();
+            }
+        }
+        break;
+    case ESPReactWifiManager::ConnectState::Beginning:
+        beginStation();
+        isConnecting = false;
+        setConnectState(ESPReactWifiManager::ConnectState::AwaitingIp);
+        break;
+    case ESPReactWifiManager::ConnectState::AwaitingIp:
+        if (fastConnectAttempt) {
+            fallbackFromFastConnect();
+        } else {
+            failTimedOutAttempt();
+        }
+        break;
+    default:
+        break;
+    }
+}
 
-    Serial.print(F("Local: "));
-    Serial.println(WiFi.localIP());
+void setupAP() {
+    bool success = WiFi.softAPConfig(
+        apIP,
+        apIP,
+        IPAddress(255, 255, 255, 0));
+    if (!success) {
+        WM_LOGE("Error setting static IP for AP mode");
+        ESP.restart();
+        return;
+    }
+    snprintf_P(captivePortalUrl, sizeof(captivePortalUrl), PSTR("http://%u.%u.%u.%u/wifi.html"),
+               apIP[0], apIP[1], apIP[2], apIP[3]);
+}
 
-    bool isLocal = WiFi.localIP() == request->client()->localIP();
+void checkRetryCount(uint8_t reason) {
+    if (fastConnectAttempt && !isConnecting) {
+        fallbackFromFastConnect();
+        return;
+    }
 
-    if (!isLocal && captiveCallback && captiveCallback(request)) {
+    // a plain AP is not disturbed by retries while someone uses the portal,
+    // with AP+STA provisioning the portal waits for this result
+    if (isConnecting || (!provisioningConnect && WiFi.softAPgetStationNum() > 0)) {
+        return;
+    }
+    if (attemptFailed) {
         return;
     }
+    attemptFailed = true;
+    timers.cancel(ConnectStepTimer);
+
+    DisconnectKind kind = credentialsWorked ? DisconnectKind::Transient : classifyDisconnect(reason);
+    WM_LOGI("Station disconnected, reason %u", reason);
+    if (kind != DisconnectKind::Transient && retryCount < retryLimit) {
+        // retrying a rejected password or a network that is not there only
+        // delays the portal
+        retryCount = retryLimit;
+    }
 
-    if (!isLocal) {
-        Serial.print(F("Request redirected to captive portal: "));
-        Serial.println(request->url());
-        String redirect = String(F("http://"))
-                + request->client()->localIP().toString()
-                + String(F("/wifi.html"));
-        Serial.print(F("To: "));
-        Serial.println(redirect);
+    ++wifiMetrics.disconnects;
+    recordNetworkFailure();
+    if (roamPending) {
+        roamPending = false;
+        ++roamCounters.failures;
+    }
 
-        request->redirect(redirect);
-        return;
+    if (!reconnectBackoff.seeded()) {
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        reconnectBackoff.seed(mac, sizeof(mac));
     }
 
-    if (notFoundCallback) {
-        notFoundCallback(request);
+    bool exhausted = ++retryCount > retryLimit;
+    uint32_t retryDelay = reconnectBackoff.next();
+    if (exhausted && fallbackToAp) {
+        retryDelay += apRetryInterval;
+    }
+    WM_LOGD("Reconnect attempt %u in %u ms", reconnectBackoff.attempts(), static_cast<unsigned>(retryDelay));
+
+    startTimer(ReconnectTimer, retryDelay);
+    if (exhausted && fallbackToAp) {
+        ++wifiMetrics.apFallbacks;
+        pushConnectFailure(failureText(kind, reason, true), reason);
+        setConnectState(ESPReactWifiManager::ConnectState::Failed);
+        // the provisioning AP is still up, no need to rebuild it
+        if (!provisioningConnect) {
+            instance->startAP();
+        }
+    } else if (provisioningConnect || kind != DisconnectKind::Transient) {
+        pushConnectFailure(failureText(kind, reason, exhausted), reason);
     }
 }
 
-void connectToWifi()
+void failTimedOutAttempt()
 {
-    if (!instance) {
-        return;
+    WM_LOGW("No %s %u ms after begin", associated ? "IP" : "association",
+            static_cast<unsigned>(millis() - connectBeganAt));
+    ++wifiMetrics.connectTimeouts;
+    checkRetryCount(timeoutReason);
+    // the disconnect event of the abandoned attempt is not counted again
+    if (attemptFailed) {
+        disconnectStation();
     }
-
-    instance->connect();
 }
 
-void setupAP() {
-    bool success = WiFi.softAPConfig(
-        IPAddress(8, 8, 8, 8),
-        IPAddress(8, 8, 8, 8),
-        IPAddress(255, 255, 255, 0));
-    if (!success) {
-        Serial.println(F("Error setting static IP for AP mode"));
-        ESP.restart();
+void shutDownProvisioningAp()
+{
+    if (!apActive || currentConnectState != ESPReactWifiManager::ConnectState::Connected) {
         return;
     }
+    WM_LOGI("Provisioned, stopping AP");
+    WiFi.softAPdisconnect(true);
+    apActive = false;
+    provisioningConnect = false;
+    if (dnsStarted) {
+        dnsUdp.stop();
+        dnsStarted = false;
+    }
 }
 
-void checkRetryCount() {
-    if (isConnecting || WiFi.softAPgetStationNum() > 0) {
+void recordAssociated()
+{
+    if (associated || currentConnectState != ESPReactWifiManager::ConnectState::AwaitingIp) {
         return;
     }
+    associated = true;
+    if (!fastConnectAttempt) {
+        startTimer(ConnectStepTimer, dhcpTimeout);
+    }
+    wifiMetrics.associateMs.record(millis() - connectBeganAt);
+    sampleHeap(HeapPhase::Associated);
+}
 
-    if (++retryCount <= retryLimit || !fallbackToAp) {
-        wifiReconnectTimer.once(wifiReconnectDelay, connectToWifi);
-    } else {
-        shouldConnect = millis() + reconnectInterval;
-        instance->startAP();
+// disconnects the manager caused itself or that belong to an attempt that is
+// already over; they would otherwise fail the current one
+bool staleDisconnect(const QueuedWifiEvent& queued)
+{
+    bool own = selfDisconnectPending && isOwnDisconnect(queued.reason);
+    if (own) {
+        selfDisconnectPending = false;
+    }
+    if (own || queued.attempt != stationAttempt) {
+        WM_LOGD("Ignoring disconnect, reason %u", queued.reason);
+        return true;
     }
+    return false;
+}
+
+void queueWifiEvent(uint8_t event, uint8_t reason = 0)
+{
+    QueuedWifiEvent queued;
+    queued.event = event;
+    queued.reason = reason;
+    queued.attempt = stationAttempt;
+    wifiEvents.push(queued);
+    wakeTask();
 }
 
 #if defined(ESP32)
-void WiFiEvent(WiFiEvent_t event) {
-    Serial.print("[WiFi-event] event: ");
-    switch(event) {
+void WiFiEvent(system_event_t* event) {
+    uint8_t reason = 0;
+    if (event->event_id == SYSTEM_EVENT_STA_DISCONNECTED) {
+        reason = event->event_info.disconnected.reason;
+    }
+    queueWifiEvent(event->event_id, reason);
+}
 
-    case SYSTEM_EVENT_WIFI_READY:
-        Serial.println("SYSTEM_EVENT_WIFI_READY");
-        break;
-    case SYSTEM_EVENT_SCAN_DONE:
-        Serial.println("SYSTEM_EVENT_SCAN_DONE");
-        break;
-    case SYSTEM_EVENT_STA_START:
-        Serial.println("SYSTEM_EVENT_STA_START");
-        break;
-    case SYSTEM_EVENT_STA_STOP:
-        Serial.println("SYSTEM_EVENT_STA_STOP");
-        break;
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_DEBUG
+const char* wifiEventName(uint8_t event) {
+    switch (event) {
+    case SYSTEM_EVENT_WIFI_READY: return PSTR("SYSTEM_EVENT_WIFI_READY");
+    case SYSTEM_EVENT_SCAN_DONE: return PSTR("SYSTEM_EVENT_SCAN_DONE");
+    case SYSTEM_EVENT_STA_START: return PSTR("SYSTEM_EVENT_STA_START");
+    case SYSTEM_EVENT_STA_STOP: return PSTR("SYSTEM_EVENT_STA_STOP");
+    case SYSTEM_EVENT_STA_CONNECTED: return PSTR("SYSTEM_EVENT_STA_CONNECTED");
+    case SYSTEM_EVENT_STA_DISCONNECTED: return PSTR("SYSTEM_EVENT_STA_DISCONNECTED");
+    case SYSTEM_EVENT_STA_AUTHMODE_CHANGE: return PSTR("SYSTEM_EVENT_STA_AUTHMODE_CHANGE");
+    case SYSTEM_EVENT_STA_GOT_IP: return PSTR("SYSTEM_EVENT_STA_GOT_IP");
+    case SYSTEM_EVENT_STA_LOST_IP: return PSTR("SYSTEM_EVENT_STA_LOST_IP");
+    case SYSTEM_EVENT_STA_WPS_ER_SUCCESS: return PSTR("SYSTEM_EVENT_STA_WPS_ER_SUCCESS");
+    case SYSTEM_EVENT_STA_WPS_ER_FAILED: return PSTR("SYSTEM_EVENT_STA_WPS_ER_FAILED");
+    case SYSTEM_EVENT_STA_WPS_ER_TIMEOUT: return PSTR("SYSTEM_EVENT_STA_WPS_ER_TIMEOUT");
+    case SYSTEM_EVENT_STA_WPS_ER_PIN: return PSTR("SYSTEM_EVENT_STA_WPS_ER_PIN");
+    case SYSTEM_EVENT_STA_WPS_ER_PBC_OVERLAP: return PSTR("SYSTEM_EVENT_STA_WPS_ER_PBC_OVERLAP");
+    case SYSTEM_EVENT_AP_START: return PSTR("SYSTEM_EVENT_AP_START");
+    case SYSTEM_EVENT_AP_STOP: return PSTR("SYSTEM_EVENT_AP_STOP");
+    case SYSTEM_EVENT_AP_STACONNECTED: return PSTR("SYSTEM_EVENT_AP_STACONNECTED");
+    case SYSTEM_EVENT_AP_STADISCONNECTED: return PSTR("SYSTEM_EVENT_AP_STADISCONNECTED");
+    case SYSTEM_EVENT_AP_STAIPASSIGNED: return PSTR("SYSTEM_EVENT_AP_STAIPASSIGNED");
+    case SYSTEM_EVENT_AP_PROBEREQRECVED: return PSTR("SYSTEM_EVENT_AP_PROBEREQRECVED");
+    case SYSTEM_EVENT_GOT_IP6: return PSTR("SYSTEM_EVENT_GOT_IP6");
+    case SYSTEM_EVENT_ETH_START: return PSTR("SYSTEM_EVENT_ETH_START");
+    case SYSTEM_EVENT_ETH_STOP: return PSTR("SYSTEM_EVENT_ETH_STOP");
+    case SYSTEM_EVENT_ETH_CONNECTED: return PSTR("SYSTEM_EVENT_ETH_CONNECTED");
+    case SYSTEM_EVENT_ETH_DISCONNECTED: return PSTR("SYSTEM_EVENT_ETH_DISCONNECTED");
+    case SYSTEM_EVENT_ETH_GOT_IP: return PSTR("SYSTEM_EVENT_ETH_GOT_IP");
+    case SYSTEM_EVENT_MAX: return PSTR("SYSTEM_EVENT_MAX");
+    default: return PSTR("UNKNOWN");
+    }
+}
+#endif
+
+void processWifiEvent(const QueuedWifiEvent& queued) {
+    WM_LOGD("[WiFi-event] event: %s", wifiEventName(queued.event));
+    switch (queued.event) {
     case SYSTEM_EVENT_STA_CONNECTED:
-        Serial.println("SYSTEM_EVENT_STA_CONNECTED");
+        recordAssociated();
         break;
     case SYSTEM_EVENT_STA_DISCONNECTED:
-        Serial.println("SYSTEM_EVENT_STA_DISCONNECTED");
-        checkRetryCount();
-        break;
-    case SYSTEM_EVENT_STA_AUTHMODE_CHANGE:
-        Serial.println("SYSTEM_EVENT_STA_AUTHMODE_CHANGE");
+        if (!staleDisconnect(queued)) {
+            checkRetryCount(queued.reason);
+        }
         break;
     case SYSTEM_EVENT_STA_GOT_IP:
-        Serial.println("SYSTEM_EVENT_STA_GOT_IP");
         instance->finishConnection(false);
         break;
-    case SYSTEM_EVENT_STA_LOST_IP:
-        Serial.println("SYSTEM_EVENT_STA_LOST_IP");
-        break;
-    case SYSTEM_EVENT_STA_WPS_ER_SUCCESS:
-        Serial.println("SYSTEM_EVENT_STA_WPS_ER_SUCCESS");
+    case SYSTEM_EVENT_AP_STACONNECTED:
+        // usually answered by the scan made when the AP started
+        instance->scheduleScan(apClientScanDelay);
         break;
-    case SYSTEM_EVENT_STA_WPS_ER_FAILED:
-        Serial.println("SYSTEM_EVENT_STA_WPS_ER_FAILED");
+    default:
         break;
-    case SYSTEM_EVENT_STA_WPS_ER_TIMEOUT:
-        Serial.println("SYSTEM_EVENT_STA_WPS_ER_TIMEOUT");
+    }
+}
+#else
+void onWifiAssociated(const WiFiEventStationModeConnected& event) {
+    queueWifiEvent(STA_CONNECTED_EVENT);
+}
+
+void onWifiConnect(const WiFiEventStationModeGotIP& event) {
+    queueWifiEvent(STA_GOT_IP_EVENT);
+}
+
+void onWifiDisconnect(const WiFiEventStationModeDisconnected& event) {
+    queueWifiEvent(STA_DISCONNECTED_EVENT, event.reason);
+}
+
+void processWifiEvent(const QueuedWifiEvent& queued) {
+    switch (queued.event) {
+    case STA_CONNECTED_EVENT:
+        recordAssociated();
         break;
-    case SYSTEM_EVENT_STA_WPS_ER_PIN:
-        Serial.println("SYSTEM_EVENT_STA_WPS_ER_PIN");
+    case STA_GOT_IP_EVENT:
+        instance->finishConnection(false);
         break;
-    case SYSTEM_EVENT_STA_WPS_ER_PBC_OVERLAP:
-        Serial.println("SYSTEM_EVENT_STA_WPS_ER_PBC_OVERLAP");
+    case STA_DISCONNECTED_EVENT:
+        WM_LOGI("Disconnected from Wi-Fi.");
+        if (!staleDisconnect(queued)) {
+            checkRetryCount(queued.reason);
+        }
         break;
-    case SYSTEM_EVENT_AP_START:
-        Serial.println("SYSTEM_EVENT_AP_START");
+    }
+}
+#endif
+}
+
+WifiMetrics::WifiMetrics()
+    : associateMs(connectTimeBounds)
+    , ipMs(connectTimeBounds)
+    , scanMs(scanTimeBounds)
+    , scanNetworks(networkCountBounds)
+    , probeMs(probeTimeBounds)
+    , retries(retryCountBounds)
+    , dnsBatch(dnsBatchBounds)
+{
+    reset();
+}
+
+void WifiMetrics::reset()
+{
+    connectAttempts = 0;
+    connects = 0;
+    disconnects = 0;
+    apFallbacks = 0;
+    connectTimeouts = 0;
+    scans = 0;
+    scanFailures = 0;
+    scanCacheHits = 0;
+    scansCoalesced = 0;
+    wifiListRequests = 0;
+    wifiListNotModified = 0;
+    wifiListBytes = 0;
+    dnsQueries = 0;
+    dnsBudgetHits = 0;
+    associateMs.reset();
+    ipMs.reset();
+    scanMs.reset();
+    scanNetworks.reset();
+    probeMs.reset();
+    retries.reset();
+    dnsBatch.reset();
+    memset(heap, 0, sizeof(heap));
+}
+
+ESPReactWifiManager::ESPReactWifiManager()
+{
+    instance = this;
+    // ETags of a previous boot must not match the first scan of this one
+    scanGeneration = random(0x7fffffff);
+    // indexed again on first use, like after a reboot
+    knownNetworksLoaded = false;
+    currentNetwork = -1;
+    loadedNetwork = -1;
+    preferredNetwork = -1;
+
+#if defined(ESP8266)
+    wifiAssociatedHandler = WiFi.onStationModeConnected(onWifiAssociated);
+    wifiConnectHandler = WiFi.onStationModeGotIP(onWifiConnect);
+    wifiDisconnectHandler = WiFi.onStationModeDisconnected(onWifiDisconnect);
+#else
+    WiFi.onEvent(WiFiEvent);
+#endif
+}
+
+void onTimer(uint8_t timer)
+{
+    switch (timer) {
+    case ConnectStepTimer:
+        stepConnect();
         break;
-    case SYSTEM_EVENT_AP_STOP:
-        Serial.println("SYSTEM_EVENT_AP_STOP");
+    case ReconnectTimer:
+        if (WiFi.status() == WL_CONNECTED) {
+            break;
+        }
+        // the portal is in use, the retry would take it away
+        if (apActive && !apStaProvisioning && WiFi.softAPgetStationNum() > 0) {
+            startTimer(ReconnectTimer, apRetryInterval);
+            break;
+        }
+        instance->connect();
         break;
-    case SYSTEM_EVENT_AP_STACONNECTED:
-        Serial.println("SYSTEM_EVENT_AP_STACONNECTED");
-        instance->scheduleScan(200);
+    case ScanTimer:
+        // a probe holds the radio for a few ms
+        if (scanInProgress && probePurpose != ProbePurpose::None) {
+            startTimer(ScanTimer, scanPollInterval);
+        } else {
+            instance->scan();
+        }
         break;
-    case SYSTEM_EVENT_AP_STADISCONNECTED:
-        Serial.println("SYSTEM_EVENT_AP_STADISCONNECTED");
+    case ScanPollTimer:
+        pollScan();
+        if (scanInProgress) {
+            startTimer(ScanPollTimer, scanPollInterval);
+        }
         break;
-    case SYSTEM_EVENT_AP_STAIPASSIGNED:
-        Serial.println("SYSTEM_EVENT_AP_STAIPASSIGNED");
+    case RoamTimer:
+        pollRoaming(millis());
         break;
-    case SYSTEM_EVENT_AP_PROBEREQRECVED:
-        Serial.println("SYSTEM_EVENT_AP_PROBEREQRECVED");
+    case ApShutdownTimer:
+        shutDownProvisioningAp();
         break;
-    case SYSTEM_EVENT_GOT_IP6:
-        Serial.println("SYSTEM_EVENT_GOT_IP6");
+    case WifiListTimer:
+        if (!publishWifiList()) {
+            startTimer(WifiListTimer, wifiListRetryInterval);
+        }
         break;
-    case SYSTEM_EVENT_ETH_START:
-        Serial.println("SYSTEM_EVENT_ETH_START");
+    }
+}
+
+void runCommand(const QueuedCommand& queued)
+{
+    switch (queued.command) {
+    case TaskCommand::Connect:
+        instance->connect();
         break;
-    case SYSTEM_EVENT_ETH_STOP:
-        Serial.println("SYSTEM_EVENT_ETH_STOP");
+    case TaskCommand::AutoConnect:
+        instance->autoConnect();
         break;
-    case SYSTEM_EVENT_ETH_CONNECTED:
-        Serial.println("SYSTEM_EVENT_ETH_CONNECTED");
+    case TaskCommand::Disconnect:
+        instance->disconnect();
         break;
-    case SYSTEM_EVENT_ETH_DISCONNECTED:
-        Serial.println("SYSTEM_EVENT_ETH_DISCONNECTED");
+    case TaskCommand::StartAP:
+        instance->startAP();
         break;
-    case SYSTEM_EVENT_ETH_GOT_IP:
-        Serial.println("SYSTEM_EVENT_ETH_GOT_IP");
+    case TaskCommand::Scan:
+        instance->scan();
         break;
-    case SYSTEM_EVENT_MAX:
-        Serial.println("SYSTEM_EVENT_MAX");
+    case TaskCommand::ScheduleScan:
+        instance->scheduleScan(queued.argument);
         break;
     }
 }
-#else
-void onWifiConnect(const WiFiEventStationModeGotIP& event) {
-    Serial.println("Connected to Wi-Fi.");
-    instance->finishConnection(false);
+
+void serviceLoop()
+{
+    QueuedCommand command;
+    while (taskCommands.pop(command)) {
+        runCommand(command);
+    }
+
+    if (dnsStarted) {
+        serveDns();
+    }
+
+    QueuedWifiEvent queued;
+    while (wifiEvents.pop(queued)) {
+        processWifiEvent(queued);
+    }
+
+    PendingSave save;
+    if (pendingSaves.pop(save)) {
+        applyPendingSave(save);
+    }
+
+    if (scanRefreshRequested.exchange(false)) {
+        instance->scheduleScan(0);
+    }
+
+    QueuedProbe probe;
+    if (!scanInProgress && probeRequests.pop(probe)) {
+        startProbe(ProbePurpose::User, probe.ssid, probe.channel, false);
+    }
+
+    timers.advance(millis(), onTimer);
 }
 
-void onWifiDisconnect(const WiFiEventStationModeDisconnected& event) {
-    Serial.println("Disconnected from Wi-Fi.");
-    checkRetryCount();
+#if defined(ESP32)
+uint32_t taskStep()
+{
+    serviceLoop();
+    return std::min(instance->timeUntilNextDeadline(), dnsStarted ? taskDnsPollInterval : taskMaxSleep);
 }
 #endif
-}
 
-ESPReactWifiManager::ESPReactWifiManager()
+void ESPReactWifiManager::loop()
 {
-    instance = this;
-
-#if defined(ESP8266)
-    wifiConnectHandler = WiFi.onStationModeGotIP(onWifiConnect);
-    wifiDisconnectHandler = WiFi.onStationModeDisconnected(onWifiDisconnect);
-#else
-    WiFi.onEvent(WiFiEvent);
+#if defined(ESP32)
+    if (connectivityTask.running()) {
+        return;
+    }
 #endif
+    serviceLoop();
 }
 
-void ESPReactWifiManager::loop()
+uint32_t ESPReactWifiManager::timeUntilNextDeadline()
 {
-    if (dnsServer) {
-        dnsServer->processNextRequest();
+    if (!wifiEvents.empty() || !pendingSaves.empty() || !taskCommands.empty() || scanRefreshRequested
+            || (!probeRequests.empty() && !scanInProgress)) {
+        return 0;
     }
+    return timers.timeUntilNext(millis());
+}
 
-    uint32_t now = millis();
-
-    if (shouldScan > 0 && now > shouldScan) {
-        shouldScan = 0;
-
-        scan();
-    }
+#if defined(ESP32)
+bool ESPReactWifiManager::startTask(uint8_t core, uint32_t stackSize, uint8_t priority)
+{
+    WM_LOGI("Starting manager task on core %u", core);
+    return connectivityTask.start(taskStep, core, stackSize, priority);
+}
 
-    if (WiFi.status() != WL_CONNECTED && now > shouldConnect && shouldConnect > 0) {
-        shouldConnect = 0;
-        connect();
-    }
+void ESPReactWifiManager::stopTask()
+{
+    connectivityTask.stop();
 }
+#endif
 
 void ESPReactWifiManager::disconnect()
 {
+    if (fromOtherTask()) {
+        queueCommand(TaskCommand::Disconnect);
+        return;
+    }
     WiFi.softAPdisconnect(true);
-#if defined(ESP8266)
-    //trying to fix connection in progress hanging
-    ETS_UART_INTR_DISABLE();
-    wifi_station_disconnect();
-    ETS_UART_INTR_ENABLE();
-#else
-    WiFi.disconnect(false);
-#endif
+    apActive = false;
+    provisioningConnect = false;
+    timers.cancel(ApShutdownTimer);
+    disconnectStation();
 }
 
-void ESPReactWifiManager::setApOptions(String apName, String apPassword)
+void ESPReactWifiManager::setApOptions(const char* apName, const char* apPassword)
 {
-    connectApName = apName;
-    connectApPassword = apPassword;
+    connectApName = orEmpty(apName);
+    connectApPassword = orEmpty(apPassword);
 }
 
-void ESPReactWifiManager::setStaOptions(String ssid, String password, String login, String bssid)
+void ESPReactWifiManager::setApOptions(const String& apName, const String& apPassword)
 {
-    connectSsid = ssid;
-    connectPassword = password;
-    connectLogin = login;
-    connectBssid = bssid;
+    setApOptions(apName.c_str(), apPassword.c_str());
 }
 
-bool ESPReactWifiManager::connect()
+void ESPReactWifiManager::setStaOptions(const char* ssid, const char* password, const char* login, const char* bssid)
 {
-    Serial.println();
+    connectSsid = orEmpty(ssid);
+    connectPassword = orEmpty(password);
+    connectLogin = orEmpty(login);
+    connectIdentity = "";
+    connectBssid = orEmpty(bssid);
+    connectOptions = StationOptions();
+    staOptionsSet = connectSsid.length() > 0;
+    loadedNetwork = -1;
+    // new credentials get the full retry budget
+    credentialsWorked = false;
+    retryCount = 0;
+    reconnectBackoff.reset();
+}
 
-    isConnecting = true;
-    disconnect();
-    delay(1000);
-    WiFi.mode(WIFI_STA);
-    delay(1000);
-    if (!wifiHostname.isEmpty()) {
-#if defined(ESP8266)
-        WiFi.hostname(wifiHostname.c_str());
-#else
-        WiFi.setHostname(wifiHostname.c_str());
-#endif
+void ESPReactWifiManager::setStaOptions(const String& ssid, const String& password, const String& login,
+                                        const String& bssid)
+{
+    setStaOptions(ssid.c_str(), password.c_str(), login.c_str(), bssid.c_str());
+}
+
+bool ESPReactWifiManager::addNetwork(const char* ssid, const char* password, const char* login,
+                                     const char* bssid, const char* identity)
+{
+    if (!ssid || !ssid[0]) {
+        return false;
     }
+    return storeNetwork(ssid, orEmpty(password), orEmpty(login), orEmpty(bssid), orEmpty(identity)) >= 0;
+}
 
-    if (connectSsid.length() == 0) {
-        sta_config_t sta_conf;
-#if defined(ESP32)
-        wifi_config_t current_conf;
-        esp_wifi_get_config(WIFI_IF_STA, &current_conf);
-        sta_conf = current_conf.sta;
-#else
-        wifi_station_get_config_default(&sta_conf);
-#endif
-        connectSsid = String(reinterpret_cast<const char*>(sta_conf.ssid));
+bool ESPReactWifiManager::addNetwork(const String& ssid, const String& password, const String& login,
+                                     const String& bssid, const String& identity)
+{
+    return addNetwork(ssid.c_str(), password.c_str(), login.c_str(), bssid.c_str(), identity.c_str());
+}
 
-        if (connectSsid.length() == 0) {
-            isConnecting = false;
-            return false;
-        }
+bool ESPReactWifiManager::removeNetwork(const String& ssid)
+{
+    return removeNetwork(ssid.c_str());
+}
 
-        String savedPassword = String(reinterpret_cast<const char*>(sta_conf.password));
+bool ESPReactWifiManager::removeNetwork(const char* ssid)
+{
+    if (!ssid) {
+        return false;
+    }
+    WM_NETWORK_STORE_COPY(networks);
+    uint8_t count = 0;
+    readNetworks(networks, count);
+    mergeKnownSuccesses(networks, count);
+    int8_t index = findNetwork(networks, count, ssid);
+    if (index < 0) {
+        return false;
+    }
+    for (uint8_t i = index; i + 1 < count; ++i) {
+        networks[i] = networks[i + 1];
+    }
+    currentNetwork = -1;
+    preferredNetwork = -1;
+    return writeNetworks(networks, count - 1);
+}
 
-        if (savedPassword.startsWith(F("x:"))) {
-            int passwordIndex = savedPassword.indexOf(F(":"), 2);
-            connectPassword = savedPassword.substring(passwordIndex + 1);
-            connectLogin = savedPassword.substring(2, passwordIndex);
-        } else {
-            connectPassword = savedPassword;
-        }
+void ESPReactWifiManager::clearNetworks()
+{
+    SPIFFS.remove(networkStoreFile);
+    knownNetworkCount = 0;
+    knownNetworksLoaded = true;
+    networkSuccessesPending = false;
+    loadedNetwork = -1;
+    currentNetwork = -1;
+    preferredNetwork = -1;
+}
 
-        if (connectSsid.length() > 0) {
-            Serial.println(F("Connecting to last saved network"));
-        } else {
-            Serial.println(F("No last saved network"));
-            isConnecting = false;
-            return false;
-        }
-    }
+int ESPReactWifiManager::networkCount()
+{
+    loadKnownNetworks();
+    return knownNetworkCount;
+}
 
-    String tempPassword = connectPassword;
-    if (connectLogin.length() == 0) {
-        Serial.print(F("Connecting to network: "));
-        Serial.println(connectSsid);
-        Serial.flush();
-    } else {
-        Serial.print(F("Connecting to secure network: "));
-        Serial.println(connectSsid);
-        Serial.flush();
-        tempPassword = F("x:");
-        tempPassword += connectLogin;
-        tempPassword += F(":");
-        tempPassword += connectPassword;
-#if defined(ESP32)
-        esp_wpa2_config_t config = WPA2_CONFIG_INIT_DEFAULT();
-        esp_wifi_sta_wpa2_ent_enable(&config);
-#else
-        wifi_station_set_wpa2_enterprise_auth(1);
-#endif
-        esp_wifi_sta_wpa2_ent_set_identity((wifi_cred_t*)connectLogin.c_str(), connectLogin.length());
-        esp_wifi_sta_wpa2_ent_set_username((wifi_cred_t*)connectLogin.c_str(), connectLogin.length());
-        esp_wifi_sta_wpa2_ent_set_password((wifi_cred_t*)connectPassword.c_str(), connectPassword.length());
+bool ESPReactWifiManager::connect()
+{
+    if (fromOtherTask()) {
+        return queueCommand(TaskCommand::Connect);
     }
-    uint8_t mac[6] = { 0 };
-    if (connectBssid.length() > 0 && str2mac(connectBssid.c_str(), mac)) {
-        Serial.print(F("Pin to BSSID: "));
-        Serial.println(connectBssid);
-        WiFi.begin(connectSsid.c_str(), tempPassword.c_str(), 0, mac);
+    ++wifiMetrics.connectAttempts;
+    sampleHeap(HeapPhase::ConnectStart);
+    timers.cancel(ReconnectTimer);
+    isConnecting = true;
+    fastConnectAttempt = false;
+    fastConnectSkip = false;
+    provisioningConnect = apStaProvisioning && apActive;
+    if (provisioningConnect) {
+        WM_LOGI("Connecting with the AP kept up");
+        timers.cancel(ApShutdownTimer);
+        disconnectStation();
     } else {
-        WiFi.begin(connectSsid.c_str(), tempPassword.c_str());
+        disconnect();
     }
-
-    Serial.println(F("Finished connecting"));
-    isConnecting = false;
+    setConnectState(ConnectState::Disconnecting);
     return true;
 }
 
 bool ESPReactWifiManager::autoConnect()
 {
-    return connect() || startAP();
+    if (fromOtherTask()) {
+        return queueCommand(TaskCommand::AutoConnect);
+    }
+    apIfNoCredentials = true;
+    return connect();
+}
+
+ESPReactWifiManager::ConnectState ESPReactWifiManager::connectState()
+{
+    return currentConnectState;
+}
+
+void ESPReactWifiManager::setFastConnect(bool enable, bool useCachedIp)
+{
+    fastConnectEnabled = enable;
+    fastConnectStaticIp = enable && useCachedIp;
+}
+
+void ESPReactWifiManager::clearFastConnect()
+{
+    clearFastConnectRecord();
+}
+
+void ESPReactWifiManager::setReconnectBackoff(uint32_t baseMs, uint32_t capMs, float factor, BackoffJitter jitter)
+{
+    reconnectBackoff.setPolicy({ baseMs, capMs, factor, jitter });
+}
+
+void ESPReactWifiManager::setRoaming(bool enable, int8_t thresholdDbm, uint8_t hysteresisDb, uint32_t minIntervalMs)
+{
+    roamingEnabled = enable;
+    roamThreshold = thresholdDbm;
+    roamHysteresis = hysteresisDb;
+    roamInterval = minIntervalMs;
+    if (enable && currentConnectState == ConnectState::Connected) {
+        startTimer(RoamTimer, 0);
+    } else if (!enable) {
+        timers.cancel(RoamTimer);
+        roamRssi = 0;
+    }
+}
+
+ESPReactWifiManager::RoamStats ESPReactWifiManager::roamStats()
+{
+    return roamCounters;
+}
+
+void ESPReactWifiManager::onRoam(void (*func)(int8_t, int8_t))
+{
+    roamCallback = func;
+}
+
+void ESPReactWifiManager::setConnectTimeouts(uint32_t associateMs, uint32_t dhcpMs)
+{
+    associateTimeout = associateMs;
+    dhcpTimeout = dhcpMs;
+}
+
+void ESPReactWifiManager::setApStaProvisioning(bool enable, uint32_t apShutdownDelayMs)
+{
+    apStaProvisioning = enable;
+    apShutdownDelay = apShutdownDelayMs;
 }
 
 void ESPReactWifiManager::setFallbackToAp(bool enable)
@@ -445,33 +3409,46 @@ void ESPReactWifiManager::setFallbackToAp(bool enable)
     fallbackToAp = enable;
 }
 
+void ESPReactWifiManager::setApRetryInterval(uint32_t intervalMs)
+{
+    apRetryInterval = intervalMs;
+}
+
 bool ESPReactWifiManager::startAP()
 {
-    Serial.println();
+    if (fromOtherTask()) {
+        return queueCommand(TaskCommand::StartAP);
+    }
+    if (isConnectInProgress()) {
+        isConnecting = false;
+        setConnectState(ConnectState::Idle);
+    }
     disconnect();
 
     bool success = WiFi.mode(WIFI_AP);
     if (!success) {
-        Serial.println(F("Error changing mode to AP"));
+        WM_LOGE("Error changing mode to AP");
         ESP.restart();
         return false;
     }
 #if defined(ESP8266)
     setupAP();
 #endif
-    Serial.print(F("Starting AP: "));
-    Serial.println(connectApName);
+    WM_LOGI("Starting AP: %s", connectApName.c_str());
     success = WiFi.softAP(connectApName.c_str(), connectApPassword.c_str());
     if (success) {
+        apActive = true;
 #if defined(ESP32)
         delay(500);
         setupAP();
 #endif
+        sampleHeap(HeapPhase::ApStarted);
         instance->finishConnection(true);
     } else {
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_DEBUG
         WiFi.printDiag(Serial);
-        Serial.print(F("Error starting AP: "));
-        Serial.println(WiFi.status());
+#endif
+        WM_LOGE("Error starting AP: %d", WiFi.status());
         ESP.restart();
         return false;
     }
@@ -483,88 +3460,44 @@ bool ESPReactWifiManager::startAP()
 void ESPReactWifiManager::setupHandlers(AsyncWebServer *server)
 {
     if (!server) {
-        Serial.println(F("WebServer is null!"));
+        WM_LOGE("WebServer is null!");
         return;
     }
 
-    server->on(PSTR("/wifiSave"), HTTP_POST, [this](AsyncWebServerRequest* request) {
-        Serial.println("wifiSave request");
-
-        String login;
-        String password;
-        String ssid;
+    server->addHandler(new WifiSaveHandler());
 
-        String message;
+    server->addHandler(new WifiListHandler());
 
-        for (uint8_t i = 0; i < request->args(); i++) {
-            if (request->argName(i) == F("login")) {
-                login = request->arg(i);
-            }
-            if (request->argName(i) == F("password")) {
-                password = request->arg(i);
-            }
-            if (request->argName(i) == F("ssid")) {
-                ssid = request->arg(i);
-            }
-        }
-        if (ssid.length() > 0) {
-            message = F("Connect to: ");
-            message += ssid;
-            message += F(" after module reboot");
+    if (metricsEndpoint) {
+        server->on(PSTR("/wifiMetrics"), HTTP_GET, [](AsyncWebServerRequest* request) {
+            String json;
+            serializeMetrics(json);
+            request->send(200, F("application/json"), json);
+        });
+    }
+    server->addHandler(new PortalAssetHandler());
 
-            setStaOptions(ssid, password, login);
-            connect();
-        } else {
-            message = F("Wrong request. No ssid");
+    eventSource = new AsyncEventSource(F("/wifiEvents"));
+    eventSource->onConnect([](AsyncEventSourceClient* client) {
+        sendConnectProgress(client);
+        if (currentConnectState == ConnectState::Connected) {
+            sendConnected(client);
         }
-        request->send(200, F("text/html"), message);
-    });
-
-    server->on(PSTR("/wifiList"), HTTP_GET, [](AsyncWebServerRequest* request) {
-        wifiIndex = 0;
-        Serial.printf_P(PSTR("wifiList count: %zu\n"), wifiResults.size());
-        AsyncWebServerResponse* response = request->beginChunkedResponse(
-            F("application/json"),
-            [](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
-                if (index == 0) {
-                    buffer[0] = '[';
-                    return 1;
-                } else if (wifiIndex >= wifiResults.size()) {
-                    return 0;
-                } else {
-                    String security;
-                    if (wifiResults[wifiIndex].encryptionType == ENCRYPTION_NONE) {
-                        security = F("none");
-                    } else if (wifiResults[wifiIndex].encryptionType == ENCRYPTION_ENT) {
-                        security = F("WPA2");
-                    } else {
-                        security = F("WEP");
-                    }
-                    const size_t capacity = JSON_OBJECT_SIZE(3) + 31 // fields length
-                                            + security.length()
-                                            + wifiResults[wifiIndex].ssid.length();
-                    DynamicJsonDocument doc(capacity);
-                    JsonObject obj = doc.to<JsonObject>();
-                    obj[F("ssid")] = wifiResults[wifiIndex].ssid;
-                    obj[F("signalStrength")] = wifiResults[wifiIndex].quality;
-                    obj[F("security")] = security;
-                    size_t len = serializeJson(doc, (char*)buffer, maxLen);
-                    if ((wifiIndex + 1) == wifiResults.size()) {
-                        buffer[len] = ']';
-                    } else {
-                        buffer[len] = ',';
-                    }
-                    ++len;
-                    ++wifiIndex;
-                    return len;
-                }
-            });
-        request->send(response);
     });
+    server->addHandler(eventSource);
+    server->addHandler(new CaptiveProbeHandler());
 
     server->onNotFound(notFoundHandler);
 }
 
+void ESPReactWifiManager::setPortalAssets(const PortalAsset* assets, size_t count, const char* defaultPath)
+{
+    portalAssets = assets;
+    portalAssetCount = count;
+    strncpy_P(portalDefaultPath, defaultPath ? defaultPath : portalIndexPath, sizeof(portalDefaultPath) - 1);
+    portalDefaultPath[sizeof(portalDefaultPath) - 1] = 0;
+}
+
 void ESPReactWifiManager::onFinished(void (*func)(bool))
 {
     finishedCallback = func;
@@ -580,36 +3513,76 @@ void ESPReactWifiManager::onCaptiveRedirect(bool (*func)(AsyncWebServerRequest*)
     captiveCallback = func;
 }
 
+void ESPReactWifiManager::onConnectProgress(void (*func)(ConnectState))
+{
+    connectProgressCallback = func;
+}
+
 void ESPReactWifiManager::finishConnection(bool apMode)
 {
     if (apMode) {
-        Serial.println("AP started");
-        Serial.print(F("AP IP address: "));
-        Serial.println(WiFi.softAPIP());
+        char ip[16];
+        WM_LOGI("AP started, AP IP address: %s", formatIp(ip, WiFi.softAPIP()));
     } else {
-        Serial.println("Connected to Wi-Fi.");
-        Serial.print(F("AP ssid: "));
-        Serial.println(WiFi.SSID());
-        Serial.print(F("AP bssid: "));
-        Serial.println(WiFi.BSSIDstr());
-        Serial.print(F("STA IP address: "));
-        Serial.println(WiFi.localIP());
-    }
-
-    if (!dnsServer && apMode) {
-        dnsServer = new DNSServer();
-        dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
-        bool dnsOk = dnsServer->start(53, F("*"), WiFi.softAPIP());
-        Serial.printf_P(PSTR("Starting DNS server: %s\n"), dnsOk ? PSTR("success") : PSTR("fail"));
-    } else if (dnsServer && !apMode) {
-        Serial.println(F("Stopping DNS server"));
-        dnsServer->stop();
-        delete dnsServer;
-        dnsServer = nullptr;
+        char ssid[33];
+        char bssid[18];
+        char ip[16];
+        WM_LOGI("Connected to Wi-Fi. AP ssid: %s bssid: %s STA IP address: %s",
+                stationSsid(ssid), formatMac(bssid, WiFi.BSSID()), formatIp(ip, WiFi.localIP()));
+        if (fastConnectEnabled) {
+            fastConnectAttempt = false;
+            saveFastConnect();
+        }
+        ++wifiMetrics.connects;
+        wifiMetrics.ipMs.record(millis() - connectBeganAt);
+        wifiMetrics.retries.record(retryCount);
+        sampleHeap(HeapPhase::GotIp);
+        retryCount = 0;
+        reconnectBackoff.reset();
+        credentialsWorked = true;
+        recordNetworkSuccess();
+        if (roamPending) {
+            roamPending = false;
+            ++roamCounters.roams;
+            roamCounters.rssiAfter = WiFi.RSSI();
+            if (roamCallback) {
+                roamCallback(roamCounters.rssiBefore, roamCounters.rssiAfter);
+            }
+        }
+        roamRssi = 0;
+        setConnectState(ConnectState::Connected);
+        if (roamingEnabled) {
+            startTimer(RoamTimer, 0);
+        }
+        if (hasEventClients()) {
+            sendConnected(nullptr);
+        }
+        if (provisioningConnect) {
+            startTimer(ApShutdownTimer, apShutdownDelay);
+        }
+    }
+
+    if (!dnsStarted && apMode) {
+        captiveDns.setAddress(WiFi.softAPIP());
+        dnsStarted = dnsUdp.begin(53);
+        if (dnsStarted) {
+            WM_LOGI("Started DNS server");
+        } else {
+            WM_LOGE("Error starting DNS server");
+        }
+    } else if (dnsStarted && !apMode && !apActive) {
+        WM_LOGI("Stopping DNS server");
+        dnsUdp.stop();
+        dnsStarted = false;
     }
 
 #if defined(ESP8266)
     scheduleScan();
+#else
+    // fill the cache before the first client joins
+    if (apMode) {
+        scheduleScan();
+    }
 #endif
 
     if (finishedCallback) {
@@ -619,90 +3592,183 @@ void ESPReactWifiManager::finishConnection(bool apMode)
 
 void ESPReactWifiManager::scheduleScan(int timeout)
 {
-    Serial.println(F("scheduleScan"));
-    shouldScan = millis() + timeout;
+    if (fromOtherTask()) {
+        queueCommand(TaskCommand::ScheduleScan, timeout);
+        return;
+    }
+    if ((scanInProgress && probePurpose == ProbePurpose::None) || timers.pending(ScanTimer)) {
+        WM_LOGD("scheduleScan: coalesced");
+        ++wifiMetrics.scansCoalesced;
+        return;
+    }
+    if (scanCached && millis() - scanCachedAt < scanCacheTtl) {
+        WM_LOGD("scheduleScan: results are %u ms old", static_cast<unsigned>(millis() - scanCachedAt));
+        ++wifiMetrics.scanCacheHits;
+        return;
+    }
+    WM_LOGD("scheduleScan");
+    startTimer(ScanTimer, timeout);
 }
 
-bool ESPReactWifiManager::scan()
+bool ESPReactWifiManager::probe(const char* ssid, uint8_t channel)
 {
-    wifi_ssid_count_t n = WiFi.scanNetworks();
-    Serial.println(F("Scan done"));
-    if (n == WIFI_SCAN_FAILED) {
-        Serial.println(F("scanNetworks returned: WIFI_SCAN_FAILED!"));
-        return false;
-    } else if (n == WIFI_SCAN_RUNNING) {
-        Serial.println(F("scanNetworks returned: WIFI_SCAN_RUNNING!"));
+    size_t length = ssid ? strlen(ssid) : 0;
+    if (length == 0 || length >= sizeof(QueuedProbe::ssid)) {
         return false;
-    } else if (n < 0) {
-        Serial.print(F("scanNetworks failed with unknown error code: "));
-        Serial.println(n);
+    }
+    // queued while a scan holds the radio and when called from another task
+    if (fromOtherTask() || scanInProgress) {
+        QueuedProbe queued;
+        memcpy(queued.ssid, ssid, length + 1);
+        queued.channel = channel;
+        bool queuedOk = probeRequests.push(queued);
+        wakeTask();
+        return queuedOk;
+    }
+    return startProbe(ProbePurpose::User, ssid, channel, false);
+}
+
+bool ESPReactWifiManager::probe(const String& ssid, uint8_t channel)
+{
+    return probe(ssid.c_str(), channel);
+}
+
+void ESPReactWifiManager::onProbe(void (*func)(bool found, const WifiRecord& best))
+{
+    probeCallback = func;
+}
+
+void ESPReactWifiManager::setConnectProbe(bool enable)
+{
+    connectProbeEnabled = enable;
+}
+
+void ESPReactWifiManager::setScanCacheTtl(uint32_t ttlMs)
+{
+    scanCacheTtl = ttlMs;
+}
+
+bool ESPReactWifiManager::scan()
+{
+    if (fromOtherTask()) {
+        return queueCommand(TaskCommand::Scan);
+    }
+    if (asyncScan) {
+        return startScan(scanPerChannel);
+    }
+    if (scanInProgress) {
+        WM_LOGD("Probe in progress");
         return false;
-    } else if (n == 0) {
-        Serial.println(F("No networks found"));
+    }
+
+    scanStartedAt = millis();
+    wifi_ssid_count_t n = WiFi.scanNetworks();
+    WM_LOGD("Scan done");
+    if (!checkScanCount(n)) {
+        ++wifiMetrics.scanFailures;
         return false;
-    } else {
-        Serial.print(F("Found networks: "));
-        Serial.println(n);
-        wifiResults.clear();
-        for (wifi_ssid_count_t i = 0; i < n; i++) {
-            WifiResult result;
-            bool res = WiFi.getNetworkInfo(i, result.ssid, result.encryptionType,
-                result.rssi, result.bssid, result.channel
-#if defined(ESP8266)
-                ,
-                result.isHidden
-#endif
-            );
+    }
 
-            if (!res) {
-                Serial.printf_P(PSTR("Error getNetworkInfo for %d\n"), i);
-            } else {
-                if (result.ssid.length() == 0) {
-                    continue;
-                }
+    resetStaging();
+    readScanResults(n);
+    publishScanResults();
+    recordScan(wifiPoolSize[publishedPool]);
+    serializeWifiList();
+    pushScanDelta();
 
-                result.quality = 0;
+    return true;
+}
 
-                if (result.rssi <= -100) {
-                    result.quality = 0;
-                } else if (result.rssi >= -50) {
-                    result.quality = 100;
-                } else {
-                    result.quality = 2 * (result.rssi + 100);
-                }
+void ESPReactWifiManager::setAsyncScan(bool enable, bool perChannel)
+{
+    asyncScan = enable;
+    scanPerChannel = enable && perChannel;
+}
 
-                Serial.printf("index: %d\n", i);
-                Serial.printf("ssid: %s\n", result.ssid.c_str());
-                Serial.printf("bssid: %02X:%02X:%02X:%02X:%02X:%02X\n", result.bssid[0]
-                                                          , result.bssid[1]
-                                                          , result.bssid[2]
-                                                          , result.bssid[3]
-                                                          , result.bssid[4]
-                                                          , result.bssid[5]);
+bool ESPReactWifiManager::isScanning()
+{
+    return scanInProgress;
+}
 
-                wifiResults.push_back(result);
-            }
-        }
+void ESPReactWifiManager::onScanEvent(void (*func)(ScanEvent))
+{
+    scanEventCallback = func;
+}
 
-        sort(wifiResults.begin(), wifiResults.end(), ssidLess);
-        wifiResults.erase(unique(wifiResults.begin(), wifiResults.end(), ssidEqual), wifiResults.end());
-        sort(wifiResults.begin(), wifiResults.end(), signalLess);
+void ESPReactWifiManager::setLogLevel(uint8_t level)
+{
+    espReactLogLevel = level;
+}
 
-        return true;
-    }
+void ESPReactWifiManager::onLog(void (*func)(uint8_t, const char*))
+{
+    espReactLogSetSink(func);
+}
+
+const WifiMetrics& ESPReactWifiManager::metrics()
+{
+    return wifiMetrics;
+}
+
+void ESPReactWifiManager::resetMetrics()
+{
+    wifiMetrics.reset();
+}
+
+void ESPReactWifiManager::setMetricsEndpoint(bool enable)
+{
+    metricsEndpoint = enable;
+}
+
+uint32_t ESPReactWifiManager::captiveProbesServed()
+{
+    return captiveProbeCount;
+}
+
+void ESPReactWifiManager::setDnsBudget(uint8_t packets)
+{
+    dnsBudget = packets > 0 ? packets : 1;
+}
+
+uint32_t ESPReactWifiManager::droppedEvents()
+{
+    return wifiEvents.dropped();
 }
 
 int ESPReactWifiManager::size()
 {
-    return wifiResults.size();
+    return wifiPoolSize[publishedPool];
+}
+
+void ESPReactWifiManager::setHostname(const char* hostname)
+{
+    wifiHostname = orEmpty(hostname);
 }
 
-void ESPReactWifiManager::setHostname(String hostname)
+void ESPReactWifiManager::setHostname(const String& hostname)
 {
-    wifiHostname = hostname;
+    setHostname(hostname.c_str());
 }
 
 std::vector<ESPReactWifiManager::WifiResult> ESPReactWifiManager::results()
 {
-    return wifiResults;
+    std::vector<WifiResult> results;
+    results.reserve(wifiPoolSize[publishedPool]);
+    for (const WifiRecord& record : resultsView()) {
+        WifiResult result;
+        result.ssid = record.ssid;
+        result.encryptionType = record.encryptionType;
+        result.rssi = record.rssi;
+        result.bssid = const_cast<uint8_t*>(record.bssid);
+        result.channel = record.channel;
+        result.quality = record.quality;
+        result.isHidden = record.isHidden;
+        results.push_back(result);
+    }
+    return results;
+}
+
+ESPReactWifiManager::WifiResultsView ESPReactWifiManager::resultsView()
+{
+    return WifiResultsView(wifiPools[publishedPool], wifiPoolSize[publishedPool]);
 }
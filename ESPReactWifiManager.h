@@ -1,6 +1,26 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ESPReactWifiManagerAssets.h>
+#include <ESPReactWifiManagerBackoff.h>
+#include <ESPReactWifiManagerMetrics.h>
+
+#ifndef ESPREACT_WIFI_MAX_RESULTS
+#define ESPREACT_WIFI_MAX_RESULTS 32
+#endif
+
+#ifndef ESPREACT_WIFI_MAX_NETWORKS
+#define ESPREACT_WIFI_MAX_NETWORKS 8
+#endif
+
+// 1 keeps credentials, hostname and AP settings in fixed buffers instead of
+// String, and sizes the two /wifiList bodies and the /wifiEvents payloads
+// once: connects, disconnects and scans then run without heap allocations in
+// the library. A scan that finds both bodies still being sent publishes once
+// a response is done. Responses and events allocate in the web server.
+#ifndef ESPREACT_STATIC_MEMORY
+#define ESPREACT_STATIC_MEMORY 0
+#endif
 
 class AsyncWebServer;
 class AsyncWebServerRequest;
@@ -13,33 +33,179 @@ public:
         String ssid;
         uint8_t encryptionType;
         int32_t rssi;
-        uint8_t* bssid;
+        uint8_t* bssid; // valid until the next scan completes
         int32_t channel;
         int quality;
         bool isHidden = false;
         bool duplicate = false;
     };
 
+    struct WifiRecord {
+        char ssid[33];
+        uint8_t bssid[6];
+        int8_t rssi;
+        int8_t channel;
+        uint8_t encryptionType;
+        uint8_t quality;
+        bool isHidden;
+    };
+
+    // results of the last completed scan, valid until the next scan completes
+    class WifiResultsView {
+    public:
+        WifiResultsView(const WifiRecord* records, size_t size) : m_records(records), m_size(size) {}
+        const WifiRecord* begin() const { return m_records; }
+        const WifiRecord* end() const { return m_records + m_size; }
+        size_t size() const { return m_size; }
+        const WifiRecord& operator[](size_t index) const { return m_records[index]; }
+
+    private:
+        const WifiRecord* m_records;
+        size_t m_size;
+    };
+
+    enum class ConnectState {
+        Idle,
+        Disconnecting,
+        SwitchingMode,
+        Configuring,
+        Beginning,
+        AwaitingIp,
+        Connected,
+        Failed
+    };
+
+    struct RoamStats {
+        uint32_t scans;
+        uint32_t roams;
+        uint32_t failures;
+        int8_t rssiBefore; // of the last roam
+        int8_t rssiAfter;
+    };
+
+    enum class ScanEvent {
+        Started,
+        Completed,
+        Failed
+    };
+
     void loop();
+    // milliseconds until loop() has timed work to do, 0 if it has some now; the
+    // CPU may sleep that long, web requests and DNS still need their own wakeup
+    uint32_t timeUntilNextDeadline();
+#if defined(ESP32)
+    // moves the work of loop() into a task of its own, loop() then returns at
+    // once. connect(), autoConnect(), disconnect(), startAP(), scan() and
+    // scheduleScan() called from one other task are queued for it and return
+    // without waiting; callbacks run in the manager task. Configure first.
+    bool startTask(uint8_t core = 0, uint32_t stackSize = 8192, uint8_t priority = 2);
+    void stopTask();
+#endif
 
     void disconnect();
-    void setHostname(String hostname);
-    void setApOptions(String apName, String apPassword = String());
-    void setStaOptions(String ssid, String password = String(), String login = String(), String bssid = String());
-    bool connect();
+    // values are copied, longer ones than the SDK takes are truncated
+    // with ESPREACT_STATIC_MEMORY; nullptr is the same as ""
+    void setHostname(const char* hostname);
+    void setHostname(const String& hostname);
+    void setApOptions(const char* apName, const char* apPassword = "");
+    void setApOptions(const String& apName, const String& apPassword = String());
+    // explicit network for connect(), an empty ssid selects from the known
+    // networks. A login makes it WPA2-Enterprise, the SDK config keeps
+    // "x:login:password" so they are restored after a reboot
+    void setStaOptions(const char* ssid, const char* password = "", const char* login = "", const char* bssid = "");
+    void setStaOptions(const String& ssid, const String& password = String(), const String& login = String(),
+                       const String& bssid = String());
+    // up to ESPREACT_WIFI_MAX_NETWORKS known networks, stored on SPIFFS;
+    // connect() picks the one ranked best by the last scan's RSSI and its
+    // connect history. Repeated connects to the same network reach the
+    // store at most once an hour
+    bool addNetwork(const char* ssid, const char* password = "", const char* login = "",
+                    const char* bssid = "", const char* identity = "");
+    bool addNetwork(const String& ssid, const String& password = String(), const String& login = String(),
+                    const String& bssid = String(), const String& identity = String());
+    bool removeNetwork(const char* ssid);
+    bool removeNetwork(const String& ssid);
+    void clearNetworks();
+    int networkCount();
+    bool connect(); // returns at once, progress is reported by connectState()
     bool autoConnect();
+    ConnectState connectState();
     bool startAP();
+    // a rejected password or a network that is not on the air falls back at
+    // once, other failures after the retries
     void setFallbackToAp(bool enable);
+    // after falling back, retries from the AP run intervalMs plus the backoff
+    // delay apart, and not while a client is connected to the AP
+    void setApRetryInterval(uint32_t intervalMs = 60 * 1000);
+    // an attempt that is not associated associateMs after WiFi.begin(), or has
+    // no IP dhcpMs after associating, fails like a disconnect
+    void setConnectTimeouts(uint32_t associateMs = 15000, uint32_t dhcpMs = 10000);
+    // connects started while the AP is up run in AP+STA mode: the portal and
+    // captive DNS stay up and get the result, the AP goes down apShutdownDelayMs
+    // after the station got an IP. The AP follows the channel of the station.
+    void setApStaProvisioning(bool enable, uint32_t apShutdownDelayMs = 5000);
+    // delay between reconnect attempts, jitter is seeded from the MAC address
+    void setReconnectBackoff(uint32_t baseMs, uint32_t capMs, float factor = 2.0f,
+                             BackoffJitter jitter = BackoffJitter::Decorrelated);
+    // while connected, move to a BSSID of the same SSID stronger by hysteresisDb
+    // once the signal stays below thresholdDbm; at most one scan per minIntervalMs
+    void setRoaming(bool enable, int8_t thresholdDbm = -75, uint8_t hysteresisDb = 8,
+                    uint32_t minIntervalMs = 60 * 1000);
+    RoamStats roamStats();
+    void onRoam(void (*func)(int8_t rssiBefore, int8_t rssiAfter));
+    // reuse channel, BSSID and optionally IP of the last connection, stored on
+    // SPIFFS. The IP is reused within the first half of its DHCP lease, after
+    // a restart only when the clock is set (SNTP, RTC across deep sleep)
+    void setFastConnect(bool enable, bool useCachedIp = false);
+    void clearFastConnect();
 
+    void setMetricsEndpoint(bool enable); // serve metrics() as JSON on /wifiMetrics, before setupHandlers()
+    // /wifiList reports the age of the results in X-Scan-Age (seconds),
+    // ?refresh=1 rescans stale results and sets X-Scan-Pending.
+    // /wifiSave takes a form or a JSON body (ssid, password, login, bssid,
+    // channel, ip, gateway, subnet, dns) and connects from loop().
+    // /wifiEvents sends scan deltas, connect progress, the connected network
+    // and failures with the SDK reason code
     void setupHandlers(AsyncWebServer *server);
+    // serve the portal from a table made by tools/generate_assets.py; "/" and
+    // unknown local GETs get defaultPath (PROGMEM, nullptr for /wifi.html)
+    void setPortalAssets(const PortalAsset* assets, size_t count, const char* defaultPath = nullptr);
     void onFinished(void (*func)(bool)); // arg bool "is AP mode"
     void onNotFound(void (*func)(AsyncWebServerRequest*));
     void onCaptiveRedirect(bool (*func)(AsyncWebServerRequest*));
+    void onConnectProgress(void (*func)(ConnectState));
+    // messages above ESPREACT_LOG_LEVEL are compiled out, see ESPReactWifiManagerLog.h
+    void setLogLevel(uint8_t level);
+    void onLog(void (*func)(uint8_t level, const char* message)); // nullptr restores Serial
 
     void finishConnection(bool apMode);
+    const WifiMetrics& metrics();
+    void resetMetrics();
+    uint32_t droppedEvents(); // Wi-Fi events lost to a full event queue
+    uint32_t captiveProbesServed(); // OS connectivity checks answered in AP mode
+    // captive DNS packets handled per loop() call, the rest wait for the next one
+    void setDnsBudget(uint8_t packets);
+    // skipped while the last results are younger than the scan cache TTL,
+    // folded into a scan that is already scheduled or running
     void scheduleScan(int timeout = 2000);
-    bool scan();
+    bool scan(); // in async mode only starts the scan, see onScanEvent()
+    // 30 s by default; scheduleScan(), AP clients joining and reconnects reuse
+    // younger results. 0 scans on every scheduleScan()
+    void setScanCacheTtl(uint32_t ttlMs);
+    // directed scan for one SSID, on one channel unless it is 0: finds hidden
+    // networks and takes tens of ms on a known channel. The published scan
+    // results are left alone, the strongest answer goes to onProbe()
+    bool probe(const char* ssid, uint8_t channel = 0);
+    bool probe(const String& ssid, uint8_t channel = 0);
+    void onProbe(void (*func)(bool found, const WifiRecord& best));
+    // probe the network before each connect and join the BSSID and channel
+    // that answered, on by default. Roaming probes the current SSID as well
+    void setConnectProbe(bool enable);
+    void setAsyncScan(bool enable, bool perChannel = false);
+    bool isScanning();
+    void onScanEvent(void (*func)(ScanEvent));
     int size();
     std::vector<WifiResult> results();
+    WifiResultsView resultsView();
 
 };
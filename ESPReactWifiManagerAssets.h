@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+// One file of the portal UI compiled into flash. Tables are generated from a
+// React build directory by tools/generate_assets.py, sorted by path; every
+// pointer refers to PROGMEM and the table itself lives in PROGMEM too.
+struct PortalAsset {
+    const char* path;
+    const char* contentType;
+    const char* etag; // strong, quoted
+    const uint8_t* data;
+    uint32_t length;
+    bool gzip;
+    bool immutable; // content-hashed file name, cached for a year
+};
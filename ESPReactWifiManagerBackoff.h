@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Reconnect delay policy. Without jitter the delay is base * factor^attempt,
+// capped. Full jitter draws uniformly from [0, that delay]; decorrelated
+// jitter draws from [base, previous delay * factor], capped. Jitter is seeded
+// per device so a fleet that lost the same AP does not retry in lockstep.
+enum class BackoffJitter : uint8_t {
+    None,
+    Full,
+    Decorrelated
+};
+
+struct BackoffPolicy {
+    uint32_t baseMs;
+    uint32_t capMs;
+    float factor;
+    BackoffJitter jitter;
+};
+
+class Backoff
+{
+public:
+    explicit Backoff(const BackoffPolicy& policy)
+        : m_policy(policy)
+    {
+    }
+
+    void setPolicy(const BackoffPolicy& policy)
+    {
+        m_policy = policy;
+        reset();
+    }
+
+    const BackoffPolicy& policy() const { return m_policy; }
+
+    void seed(uint32_t seed)
+    {
+        // xorshift state must never be zero
+        m_state = seed ? seed : 0x9e3779b9;
+    }
+
+    void seed(const uint8_t* mac, size_t len)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ mac[i]) * 16777619u;
+        }
+        seed(hash);
+    }
+
+    bool seeded() const { return m_state != 0; }
+
+    void reset()
+    {
+        m_attempt = 0;
+        m_previous = 0;
+    }
+
+    uint16_t attempts() const { return m_attempt; }
+
+    // delay before the next attempt, advances the attempt counter
+    uint32_t next()
+    {
+        uint32_t ceiling = exponential();
+        uint32_t delay = ceiling;
+
+        switch (m_policy.jitter) {
+        case BackoffJitter::None:
+            break;
+        case BackoffJitter::Full:
+            delay = uniform(0, ceiling);
+            break;
+        case BackoffJitter::Decorrelated: {
+            uint32_t previous = m_previous ? m_previous : m_policy.baseMs;
+            float upper = previous * (m_policy.factor > 1.0f ? m_policy.factor : 1.0f);
+            delay = uniform(m_policy.baseMs, upper < m_policy.capMs ? static_cast<uint32_t>(upper) : m_policy.capMs);
+            break;
+        }
+        }
+
+        if (delay > m_policy.capMs) {
+            delay = m_policy.capMs;
+        }
+        m_previous = delay;
+        if (m_attempt < UINT16_MAX) {
+            ++m_attempt;
+        }
+        return delay;
+    }
+
+private:
+    uint32_t exponential() const
+    {
+        float delay = m_policy.baseMs;
+        for (uint16_t i = 0; i < m_attempt && delay < m_policy.capMs; ++i) {
+            delay *= m_policy.factor;
+        }
+        return delay < m_policy.capMs ? static_cast<uint32_t>(delay) : m_policy.capMs;
+    }
+
+    uint32_t random()
+    {
+        if (!m_state) {
+            seed(0);
+        }
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    uint32_t uniform(uint32_t low, uint32_t high)
+    {
+        if (high <= low) {
+            return low;
+        }
+        return low + random() % (high - low + 1);
+    }
+
+    BackoffPolicy m_policy;
+    uint32_t m_state = 0;
+    uint16_t m_attempt = 0;
+    uint32_t m_previous = 0;
+};
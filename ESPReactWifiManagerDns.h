@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Captive portal DNS: every A query is answered with the portal address,
+// AAAA and everything else gets an empty NOERROR reply so clients fall back
+// to IPv4 at once instead of waiting for a timeout. Replies are built in the
+// query buffer from a prebuilt answer record, nothing is allocated.
+class CaptiveDns
+{
+public:
+    static const size_t MaxQuery = 512;
+    static const size_t AnswerSize = 16;
+    // a reply is at most the query plus one answer record
+    static const size_t BufferSize = MaxQuery + AnswerSize;
+
+    // address as stored by IPAddress, first octet in the lowest byte
+    void setAddress(uint32_t address, uint32_t ttl = 60)
+    {
+        const uint8_t answer[AnswerSize] = {
+            0xc0, 0x0c,             // name: pointer to the question
+            0x00, 0x01,             // type A
+            0x00, 0x01,             // class IN
+            static_cast<uint8_t>(ttl >> 24), static_cast<uint8_t>(ttl >> 16),
+            static_cast<uint8_t>(ttl >> 8), static_cast<uint8_t>(ttl),
+            0x00, 0x04,             // rdlength
+            static_cast<uint8_t>(address), static_cast<uint8_t>(address >> 8),
+            static_cast<uint8_t>(address >> 16), static_cast<uint8_t>(address >> 24)
+        };
+        memcpy(m_answer, answer, sizeof(m_answer));
+    }
+
+    // turns the query in packet (BufferSize bytes) into the reply, returns its
+    // length or 0 when nothing should be sent back
+    size_t answer(uint8_t* packet, size_t length) const
+    {
+        if (length < headerSize || length > MaxQuery || (packet[2] & 0x80)) {
+            return 0;
+        }
+        uint8_t opcode = (packet[2] >> 3) & 0x0f;
+        uint16_t questions = (packet[4] << 8) | packet[5];
+        if (opcode != 0) {
+            return reply(packet, headerSize, rcodeNotImplemented, 0, 0);
+        }
+        if (questions != 1) {
+            return reply(packet, headerSize, rcodeFormatError, 0, 0);
+        }
+
+        // uncompressed name, then type and class
+        size_t position = headerSize;
+        size_t nameLength = 0;
+        while (position < length && packet[position] != 0) {
+            uint8_t label = packet[position];
+            nameLength += label + 1;
+            if ((label & 0xc0) || nameLength > 255) {
+                return reply(packet, headerSize, rcodeFormatError, 0, 0);
+            }
+            position += label + 1;
+        }
+        if (position + 5 > length) {
+            return reply(packet, headerSize, rcodeFormatError, 0, 0);
+        }
+        uint16_t type = (packet[position + 1] << 8) | packet[position + 2];
+        uint16_t qclass = (packet[position + 3] << 8) | packet[position + 4];
+        size_t end = position + 5;
+
+        // EDNS and other additional records of the query are not echoed
+        if ((type == typeA || type == typeAny) && (qclass == classIn || qclass == classAny)) {
+            memcpy(packet + end, m_answer, sizeof(m_answer));
+            return reply(packet, end + sizeof(m_answer), 0, 1, 1);
+        }
+        return reply(packet, end, 0, 1, 0);
+    }
+
+private:
+    static const size_t headerSize = 12;
+    static const uint8_t rcodeFormatError = 1;
+    static const uint8_t rcodeNotImplemented = 4;
+    static const uint16_t typeA = 1;
+    static const uint16_t typeAny = 255;
+    static const uint16_t classIn = 1;
+    static const uint16_t classAny = 255;
+
+    static size_t reply(uint8_t* packet, size_t length, uint8_t rcode, uint8_t questions, uint8_t answers)
+    {
+        // QR and AA set, opcode and RD kept, no recursion available
+        packet[2] = 0x80 | (packet[2] & 0x79) | 0x04;
+        packet[3] = rcode;
+        packet[4] = 0;
+        packet[5] = questions;
+        packet[6] = 0;
+        packet[7] = answers;
+        memset(packet + 8, 0, 4);
+        return length;
+    }
+
+    uint8_t m_answer[AnswerSize] = {};
+};
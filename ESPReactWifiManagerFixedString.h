@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+// String with its buffer inline, for state that must not touch the heap.
+// Assignments longer than Capacity are truncated, like the SDK fields the
+// values end up in.
+template<size_t Capacity>
+class FixedString
+{
+public:
+    FixedString() { m_buffer[0] = 0; }
+
+    FixedString& operator=(const char* value)
+    {
+        size_t length = value ? strlen(value) : 0;
+        if (length > Capacity) {
+            length = Capacity;
+        }
+        // may alias the own buffer
+        memmove(m_buffer, value ? value : "", length);
+        m_buffer[length] = 0;
+        m_length = length;
+        return *this;
+    }
+
+    FixedString& operator=(const String& value) { return *this = value.c_str(); }
+
+    const char* c_str() const { return m_buffer; }
+    unsigned int length() const { return m_length; }
+    bool isEmpty() const { return m_length == 0; }
+
+    bool operator==(const char* value) const { return strcmp(m_buffer, value ? value : "") == 0; }
+    bool operator!=(const char* value) const { return !(*this == value); }
+
+private:
+    char m_buffer[Capacity + 1];
+    size_t m_length = 0;
+};
@@ -0,0 +1,31 @@
+#include <ESPReactWifiManagerLog.h>
+
+#include <stdarg.h>
+
+uint8_t espReactLogLevel = ESPREACT_LOG_LEVEL;
+
+namespace {
+
+void serialSink(uint8_t level, const char* message)
+{
+    Serial.println(message);
+}
+
+void (*logSink)(uint8_t, const char*) = serialSink;
+
+}
+
+void espReactLogSetSink(void (*sink)(uint8_t level, const char* message))
+{
+    logSink = sink ? sink : serialSink;
+}
+
+void espReactLog(uint8_t level, PGM_P format, ...)
+{
+    char message[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf_P(message, sizeof(message), format, args);
+    va_end(args);
+    logSink(level, message);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Compile-time log levels: messages above ESPREACT_LOG_LEVEL compile to
+// nothing, arguments included. The runtime level can only lower verbosity.
+#define ESPREACT_LOG_NONE 0
+#define ESPREACT_LOG_ERROR 1
+#define ESPREACT_LOG_WARN 2
+#define ESPREACT_LOG_INFO 3
+#define ESPREACT_LOG_DEBUG 4
+#define ESPREACT_LOG_VERBOSE 5
+
+#ifndef ESPREACT_LOG_LEVEL
+#define ESPREACT_LOG_LEVEL ESPREACT_LOG_INFO
+#endif
+
+extern uint8_t espReactLogLevel;
+
+void espReactLogSetSink(void (*sink)(uint8_t level, const char* message));
+void espReactLog(uint8_t level, PGM_P format, ...);
+
+#define WM_LOG(level, format, ...) \
+    do { \
+        if (espReactLogLevel >= level) { \
+            espReactLog(level, PSTR(format), ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_ERROR
+#define WM_LOGE(format, ...) WM_LOG(ESPREACT_LOG_ERROR, format, ##__VA_ARGS__)
+#else
+#define WM_LOGE(format, ...) do {} while (0)
+#endif
+
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_WARN
+#define WM_LOGW(format, ...) WM_LOG(ESPREACT_LOG_WARN, format, ##__VA_ARGS__)
+#else
+#define WM_LOGW(format, ...) do {} while (0)
+#endif
+
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_INFO
+#define WM_LOGI(format, ...) WM_LOG(ESPREACT_LOG_INFO, format, ##__VA_ARGS__)
+#else
+#define WM_LOGI(format, ...) do {} while (0)
+#endif
+
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_DEBUG
+#define WM_LOGD(format, ...) WM_LOG(ESPREACT_LOG_DEBUG, format, ##__VA_ARGS__)
+#else
+#define WM_LOGD(format, ...) do {} while (0)
+#endif
+
+#if ESPREACT_LOG_LEVEL >= ESPREACT_LOG_VERBOSE
+#define WM_LOGV(format, ...) WM_LOG(ESPREACT_LOG_VERBOSE, format, ##__VA_ARGS__)
+#else
+#define WM_LOGV(format, ...) do {} while (0)
+#endif
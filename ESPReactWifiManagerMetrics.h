@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-bucket histogram: bucket i counts values <= bounds[i], the last one
+// everything above bounds[Buckets - 2]. Recording never allocates.
+class MetricHistogram
+{
+public:
+    static const uint8_t Buckets = 8;
+
+    explicit MetricHistogram(const uint32_t* bounds) : m_bounds(bounds) {}
+
+    void record(uint32_t value)
+    {
+        uint8_t bucket = 0;
+        while (bucket < Buckets - 1 && value > m_bounds[bucket]) {
+            ++bucket;
+        }
+        ++m_counts[bucket];
+        ++m_count;
+        m_sum += value;
+        if (value > m_max) {
+            m_max = value;
+        }
+    }
+
+    void reset()
+    {
+        for (uint8_t i = 0; i < Buckets; ++i) {
+            m_counts[i] = 0;
+        }
+        m_count = 0;
+        m_sum = 0;
+        m_max = 0;
+    }
+
+    const uint32_t* bounds() const { return m_bounds; } // Buckets - 1 entries
+    uint32_t bucket(uint8_t index) const { return m_counts[index]; }
+    uint32_t count() const { return m_count; }
+    uint32_t sum() const { return m_sum; }
+    uint32_t max() const { return m_max; }
+
+private:
+    const uint32_t* m_bounds;
+    uint32_t m_counts[Buckets] = {};
+    uint32_t m_count = 0;
+    uint32_t m_sum = 0;
+    uint32_t m_max = 0;
+};
+
+enum class HeapPhase : uint8_t {
+    ConnectStart,
+    Associated,
+    GotIp,
+    ScanDone,
+    ApStarted,
+    Count
+};
+
+struct HeapSample {
+    uint32_t freeHeap;     // at the last time the phase was reached
+    uint32_t maxFreeBlock;
+    uint32_t minFreeHeap;  // lowest seen in this phase
+};
+
+struct WifiMetrics {
+    WifiMetrics();
+    void reset();
+
+    uint32_t connectAttempts;
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t apFallbacks;
+    uint32_t connectTimeouts; // attempts ended by the association or DHCP timeout
+    uint32_t scans;
+    uint32_t scanFailures;
+    uint32_t scanCacheHits;  // scan triggers answered by results younger than the TTL
+    uint32_t scansCoalesced; // scan triggers folded into a pending or running scan
+    uint32_t wifiListRequests;
+    uint32_t wifiListNotModified;
+    uint32_t wifiListBytes;
+    uint32_t dnsQueries;    // answered by the captive DNS
+    uint32_t dnsBudgetHits; // loop() calls that stopped at the DNS budget
+
+    MetricHistogram associateMs;   // WiFi.begin() to STA connected
+    MetricHistogram ipMs;          // WiFi.begin() to got IP
+    MetricHistogram scanMs;
+    MetricHistogram scanNetworks;
+    MetricHistogram probeMs;       // directed scans, see probe()
+    MetricHistogram retries;       // failed attempts before each connect
+    MetricHistogram dnsBatch;      // DNS packets drained per loop() call that had any
+
+    HeapSample heap[static_cast<uint8_t>(HeapPhase::Count)];
+};
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// /wifiSave fields, parsed in place from a JSON or form body. Sizes follow
+// the SDK limits, longer values are rejected instead of truncated.
+struct WifiSaveForm {
+    char ssid[33];
+    char password[65];
+    char login[65];
+    char bssid[18];
+    char channel[4];
+    char ip[16];
+    char gateway[16];
+    char subnet[16];
+    char dns[16];
+};
+
+const char saveFieldNames[][9] PROGMEM = {
+    "ssid", "password", "login", "bssid", "channel", "ip", "gateway", "subnet", "dns"
+};
+
+struct SaveField {
+    uint8_t offset;
+    uint8_t size;
+};
+
+const SaveField saveFields[] = {
+    { offsetof(WifiSaveForm, ssid), sizeof(WifiSaveForm::ssid) },
+    { offsetof(WifiSaveForm, password), sizeof(WifiSaveForm::password) },
+    { offsetof(WifiSaveForm, login), sizeof(WifiSaveForm::login) },
+    { offsetof(WifiSaveForm, bssid), sizeof(WifiSaveForm::bssid) },
+    { offsetof(WifiSaveForm, channel), sizeof(WifiSaveForm::channel) },
+    { offsetof(WifiSaveForm, ip), sizeof(WifiSaveForm::ip) },
+    { offsetof(WifiSaveForm, gateway), sizeof(WifiSaveForm::gateway) },
+    { offsetof(WifiSaveForm, subnet), sizeof(WifiSaveForm::subnet) },
+    { offsetof(WifiSaveForm, dns), sizeof(WifiSaveForm::dns) },
+};
+static_assert(sizeof(WifiSaveForm) < 256, "save field offsets are stored in uint8_t");
+static_assert(sizeof(saveFieldNames) / sizeof(saveFieldNames[0]) == sizeof(saveFields) / sizeof(saveFields[0]),
+              "every save field needs a name");
+
+inline char* findSaveField(WifiSaveForm& form, const char* name, size_t& size)
+{
+    for (size_t i = 0; i < sizeof(saveFields) / sizeof(saveFields[0]); ++i) {
+        if (strcmp_P(name, saveFieldNames[i]) == 0) {
+            size = saveFields[i].size;
+            return reinterpret_cast<char*>(&form) + saveFields[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+// Streaming parser for a JSON object with string, number or literal values.
+// The body is never buffered: values go straight into the form as chunks
+// arrive. Unknown keys are skipped whatever their value, a known field with
+// a nested value is refused. Errors are PROGMEM strings.
+class WifiSaveParser
+{
+public:
+    void begin(WifiSaveForm* form, bool json)
+    {
+        memset(form, 0, sizeof(*form));
+        m_form = form;
+        m_state = json ? State::Start : State::Done;
+        m_error = nullptr;
+    }
+
+    void feed(const uint8_t* data, size_t len)
+    {
+        for (size_t i = 0; i < len && !m_error; ++i) {
+            step(static_cast<char>(data[i]));
+        }
+    }
+
+    // form parameters, already decoded by the server
+    void assign(const char* name, const char* value, size_t length)
+    {
+        size_t size = 0;
+        char* field = findSaveField(*m_form, name, size);
+        if (!field) {
+            return;
+        }
+        if (length >= size) {
+            fail(PSTR("field too long"));
+            return;
+        }
+        memcpy(field, value, length);
+        field[length] = 0;
+    }
+
+    void fail(const char* error)
+    {
+        if (!m_error) {
+            m_error = error;
+        }
+    }
+
+    const char* finish()
+    {
+        if (m_state != State::Done) {
+            fail(PSTR("malformed JSON"));
+        }
+        return m_error;
+    }
+
+private:
+    enum class State : uint8_t {
+        Start,
+        Key,
+        KeyString,
+        Colon,
+        Value,
+        String,
+        Escape,
+        Unicode,
+        Literal,
+        Skip,
+        Next,
+        Done
+    };
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static bool isLiteral(char c)
+    {
+        return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.';
+    }
+
+    void step(char c)
+    {
+        switch (m_state) {
+        case State::Start:
+            if (c == '{') {
+                m_state = State::Key;
+            } else if (!isSpace(c)) {
+                fail(PSTR("malformed JSON"));
+            }
+            break;
+        case State::Key:
+            if (c == '"') {
+                m_inKey = true;
+                m_length = 0;
+                m_state = State::KeyString;
+            } else if (c == '}') {
+                m_state = State::Done;
+            } else if (!isSpace(c)) {
+                fail(PSTR("malformed JSON"));
+            }
+            break;
+        case State::KeyString:
+        case State::String:
+            if (c == '"') {
+                m_state = m_inKey ? State::Colon : State::Next;
+            } else if (c == '\\') {
+                m_state = State::Escape;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                fail(PSTR("malformed JSON"));
+            } else {
+                put(c);
+            }
+            break;
+        case State::Escape:
+            escape(c);
+            break;
+        case State::Unicode:
+            unicode(c);
+            break;
+        case State::Colon:
+            if (c == ':') {
+                startValue();
+            } else if (!isSpace(c)) {
+                fail(PSTR("malformed JSON"));
+            }
+            break;
+        case State::Value:
+            if (c == '"') {
+                m_state = State::String;
+            } else if ((c == '{' || c == '[') && m_value) {
+                fail(PSTR("nested values are not supported"));
+            } else if (c == '{' || c == '[') {
+                m_depth = 1;
+                m_skipString = false;
+                m_skipEscape = false;
+                m_state = State::Skip;
+            } else if (isLiteral(c)) {
+                m_state = State::Literal;
+                m_length = 0;
+                putLiteral(c);
+            } else if (!isSpace(c)) {
+                fail(PSTR("malformed JSON"));
+            }
+            break;
+        case State::Literal:
+            if (isLiteral(c)) {
+                putLiteral(c);
+                break;
+            }
+            endLiteral();
+            m_state = State::Next;
+            step(c);
+            break;
+        case State::Skip:
+            skip(c);
+            break;
+        case State::Next:
+            if (c == ',') {
+                m_state = State::Key;
+            } else if (c == '}') {
+                m_state = State::Done;
+            } else if (!isSpace(c)) {
+                fail(PSTR("malformed JSON"));
+            }
+            break;
+        case State::Done:
+            if (!isSpace(c)) {
+                fail(PSTR("malformed JSON"));
+            }
+            break;
+        }
+    }
+
+    void startValue()
+    {
+        // keys longer than the buffer match no field and are skipped
+        m_key[std::min(m_length, sizeof(m_key) - 1)] = 0;
+        m_value = m_length < sizeof(m_key) ? findSaveField(*m_form, m_key, m_size) : nullptr;
+        if (m_value) {
+            m_value[0] = 0;
+        }
+        m_inKey = false;
+        m_length = 0;
+        m_state = State::Value;
+    }
+
+    void put(char c)
+    {
+        if (m_inKey) {
+            if (m_length < sizeof(m_key) - 1) {
+                m_key[m_length] = c;
+            }
+            ++m_length;
+            return;
+        }
+        if (!m_value) {
+            return;
+        }
+        if (m_length + 1 >= m_size) {
+            fail(PSTR("field too long"));
+            return;
+        }
+        m_value[m_length++] = c;
+        m_value[m_length] = 0;
+    }
+
+    // literals are collected in m_key, a null needs no room in the field
+    void putLiteral(char c)
+    {
+        if (m_length < sizeof(m_key) - 1) {
+            m_key[m_length] = c;
+        }
+        ++m_length;
+    }
+
+    void endLiteral()
+    {
+        if (!m_value) {
+            return;
+        }
+        if (m_length >= sizeof(m_key)) {
+            fail(PSTR("field too long"));
+            return;
+        }
+        m_key[m_length] = 0;
+        if (strcmp_P(m_key, PSTR("null")) == 0) {
+            m_value[0] = 0;
+        } else if (m_length >= m_size) {
+            fail(PSTR("field too long"));
+        } else {
+            memcpy(m_value, m_key, m_length + 1);
+        }
+    }
+
+    // brackets inside strings of a skipped value do not count
+    void skip(char c)
+    {
+        if (m_skipEscape) {
+            m_skipEscape = false;
+        } else if (m_skipString) {
+            m_skipEscape = c == '\\';
+            m_skipString = c != '"';
+        } else if (c == '"') {
+            m_skipString = true;
+        } else if (c == '{' || c == '[') {
+            ++m_depth;
+        } else if ((c == '}' || c == ']') && --m_depth == 0) {
+            m_state = State::Next;
+        }
+    }
+
+    void escape(char c)
+    {
+        m_state = m_inKey ? State::KeyString : State::String;
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            put(c);
+            break;
+        case 'b':
+            put('\b');
+            break;
+        case 'f':
+            put('\f');
+            break;
+        case 'n':
+            put('\n');
+            break;
+        case 'r':
+            put('\r');
+            break;
+        case 't':
+            put('\t');
+            break;
+        case 'u':
+            m_codepoint = 0;
+            m_digits = 0;
+            m_state = State::Unicode;
+            break;
+        default:
+            fail(PSTR("malformed JSON"));
+            break;
+        }
+    }
+
+    void unicode(char c)
+    {
+        uint8_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            fail(PSTR("malformed JSON"));
+            return;
+        }
+        m_codepoint = (m_codepoint << 4) | digit;
+        if (++m_digits < 4) {
+            return;
+        }
+        m_state = m_inKey ? State::KeyString : State::String;
+        // SSIDs are at most 32 bytes, characters outside the BMP are not worth the surrogate handling
+        if (m_codepoint == 0 || (m_codepoint >= 0xd800 && m_codepoint <= 0xdfff)) {
+            fail(PSTR("unsupported escape"));
+        } else if (m_codepoint < 0x80) {
+            put(m_codepoint);
+        } else if (m_codepoint < 0x800) {
+            put(0xc0 | (m_codepoint >> 6));
+            put(0x80 | (m_codepoint & 0x3f));
+        } else {
+            put(0xe0 | (m_codepoint >> 12));
+            put(0x80 | ((m_codepoint >> 6) & 0x3f));
+            put(0x80 | (m_codepoint & 0x3f));
+        }
+    }
+
+    WifiSaveForm* m_form = nullptr;
+    State m_state = State::Done;
+    const char* m_error = nullptr;
+    bool m_inKey = false;
+    char m_key[12];
+    size_t m_length = 0;
+    char* m_value = nullptr;
+    size_t m_size = 0;
+    uint16_t m_codepoint = 0;
+    uint8_t m_digits = 0;
+    uint16_t m_depth = 0;
+    bool m_skipString = false;
+    bool m_skipEscape = false;
+};
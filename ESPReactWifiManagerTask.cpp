@@ -0,0 +1,120 @@
+#include <ESPReactWifiManagerTask.h>
+
+#if defined(ESP32)
+
+#if defined(ESPREACT_NATIVE)
+
+bool ConnectivityTask::start(Step step, uint8_t core, uint32_t stackSize, uint8_t priority)
+{
+    if (running()) {
+        return false;
+    }
+    m_step = step;
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_woken = false;
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&ConnectivityTask::run, this);
+    return true;
+}
+
+void ConnectivityTask::stop()
+{
+    if (!running()) {
+        return;
+    }
+    m_stopping.store(true, std::memory_order_release);
+    wake();
+    m_thread.join();
+}
+
+bool ConnectivityTask::isCurrent() const
+{
+    return running() && std::this_thread::get_id() == m_threadId.load(std::memory_order_acquire);
+}
+
+void ConnectivityTask::wake()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_woken = true;
+    m_condition.notify_one();
+}
+
+void ConnectivityTask::run()
+{
+    m_threadId.store(std::this_thread::get_id(), std::memory_order_release);
+    while (!m_stopping.load(std::memory_order_acquire)) {
+        uint32_t sleep = m_step();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait_for(lock, std::chrono::milliseconds(sleep), [this]() {
+            return m_woken || m_stopping.load(std::memory_order_acquire);
+        });
+        m_woken = false;
+    }
+    m_threadId.store(std::thread::id(), std::memory_order_release);
+    m_running.store(false, std::memory_order_release);
+}
+
+#else
+
+bool ConnectivityTask::start(Step step, uint8_t core, uint32_t stackSize, uint8_t priority)
+{
+    if (running()) {
+        return false;
+    }
+    m_step = step;
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_running.store(true, std::memory_order_release);
+    if (xTaskCreatePinnedToCore(trampoline, "wifiManager", stackSize, this, priority, nullptr, core) != pdPASS) {
+        m_running.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void ConnectivityTask::stop()
+{
+    if (!running()) {
+        return;
+    }
+    m_stopping.store(true, std::memory_order_release);
+    wake();
+    while (running()) {
+        vTaskDelay(1);
+    }
+}
+
+bool ConnectivityTask::isCurrent() const
+{
+    return running() && xTaskGetCurrentTaskHandle() == m_handle.load(std::memory_order_acquire);
+}
+
+void ConnectivityTask::wake()
+{
+    TaskHandle_t handle = m_handle.load(std::memory_order_acquire);
+    if (handle) {
+        xTaskNotifyGive(handle);
+    }
+}
+
+void ConnectivityTask::trampoline(void* task)
+{
+    static_cast<ConnectivityTask*>(task)->run();
+    vTaskDelete(nullptr);
+}
+
+void ConnectivityTask::run()
+{
+    m_handle.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+    while (!m_stopping.load(std::memory_order_acquire)) {
+        uint32_t sleep = m_step();
+        // at least one tick, so the idle task of this core gets to feed the watchdog
+        TickType_t ticks = pdMS_TO_TICKS(sleep);
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+    m_handle.store(nullptr, std::memory_order_release);
+    m_running.store(false, std::memory_order_release);
+}
+
+#endif
+
+#endif
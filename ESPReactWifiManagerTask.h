@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+
+#if defined(ESP32)
+#include <atomic>
+
+#if defined(ESPREACT_NATIVE)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Runs a step function over and over on a thread of execution of its own: a
+// FreeRTOS task pinned to a core on ESP32, a std::thread on the host build.
+// Each step returns how many milliseconds it may sleep, wake() ends a sleep
+// early. Only the owner starts and stops it, never from the task itself.
+class ConnectivityTask
+{
+public:
+    typedef uint32_t (*Step)();
+
+    ~ConnectivityTask() { stop(); }
+
+    bool start(Step step, uint8_t core, uint32_t stackSize, uint8_t priority);
+    void stop(); // returns once the running step has finished
+    bool running() const { return m_running.load(std::memory_order_acquire); }
+    bool isCurrent() const; // true when called from the task
+    void wake();
+
+private:
+    void run();
+
+    Step m_step = nullptr;
+    std::atomic<bool> m_running { false };
+    std::atomic<bool> m_stopping { false };
+#if defined(ESPREACT_NATIVE)
+    std::thread m_thread;
+    std::atomic<std::thread::id> m_threadId;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_woken = false;
+#else
+    static void trampoline(void* task);
+
+    // set by the task itself, the creator may not have stored it yet when it runs
+    std::atomic<TaskHandle_t> m_handle { nullptr };
+#endif
+};
+#endif
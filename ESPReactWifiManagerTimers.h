@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hashed timer wheel for a fixed set of timers, identified by index. A timer
+// is linked into the slot its deadline falls in and advance() only walks the
+// slots the clock moved across, so idle timers cost nothing per loop().
+// Deadlines further away than one turn wait in their slot for later turns.
+// Times are compared as signed differences and survive millis() wrapping.
+template<uint8_t Timers, uint8_t SlotBits = 5, uint8_t TickBits = 4>
+class TimerWheel
+{
+    static_assert(Timers > 0 && Timers <= 32, "due timers are collected in a 32 bit mask");
+
+public:
+    static const uint8_t Slots = 1 << SlotBits;
+    static const uint32_t TickMs = 1 << TickBits;
+    static const uint32_t Never = UINT32_MAX;
+
+    TimerWheel()
+    {
+        for (uint8_t i = 0; i < Slots; ++i) {
+            m_heads[i] = none;
+        }
+        for (uint8_t i = 0; i < Timers; ++i) {
+            m_next[i] = none;
+            m_armed[i] = false;
+        }
+    }
+
+    // (re)arms timer to fire delayMs after now
+    void schedule(uint8_t timer, uint32_t now, uint32_t delayMs)
+    {
+        cancel(timer);
+        if (!m_started) {
+            m_last = now;
+            m_started = true;
+        }
+        m_deadlines[timer] = now + delayMs;
+        m_armed[timer] = true;
+        uint8_t slot = slotOf(m_deadlines[timer]);
+        m_next[timer] = m_heads[slot];
+        m_heads[slot] = timer;
+    }
+
+    void cancel(uint8_t timer)
+    {
+        if (!m_armed[timer]) {
+            return;
+        }
+        m_armed[timer] = false;
+        uint8_t* link = &m_heads[slotOf(m_deadlines[timer])];
+        while (*link != timer) {
+            link = &m_next[*link];
+        }
+        *link = m_next[timer];
+        m_next[timer] = none;
+    }
+
+    bool pending(uint8_t timer) const { return m_armed[timer]; }
+
+    // fires every timer due at now, in timer order; timers armed by a
+    // callback are left for the next call
+    template<typename Fire>
+    void advance(uint32_t now, Fire fire)
+    {
+        if (!m_started) {
+            return;
+        }
+        uint32_t steps = ((now >> TickBits) - (m_last >> TickBits)) & (UINT32_MAX >> TickBits);
+        uint32_t slots = steps + 1 < Slots ? steps + 1 : Slots;
+        uint8_t slot = slotOf(m_last);
+        m_last = now;
+
+        uint32_t due = 0;
+        for (uint32_t i = 0; i < slots; ++i, slot = (slot + 1) & (Slots - 1)) {
+            uint8_t* link = &m_heads[slot];
+            while (*link != none) {
+                uint8_t timer = *link;
+                if (static_cast<int32_t>(now - m_deadlines[timer]) >= 0) {
+                    *link = m_next[timer];
+                    m_next[timer] = none;
+                    m_armed[timer] = false;
+                    due |= 1u << timer;
+                } else {
+                    link = &m_next[timer];
+                }
+            }
+        }
+        for (uint8_t timer = 0; due; ++timer, due >>= 1) {
+            if (due & 1) {
+                fire(timer);
+            }
+        }
+    }
+
+    // milliseconds until the earliest armed deadline, 0 if one is overdue
+    uint32_t timeUntilNext(uint32_t now) const
+    {
+        uint32_t next = Never;
+        for (uint8_t i = 0; i < Timers; ++i) {
+            if (!m_armed[i]) {
+                continue;
+            }
+            int32_t remaining = static_cast<int32_t>(m_deadlines[i] - now);
+            uint32_t wait = remaining > 0 ? static_cast<uint32_t>(remaining) : 0;
+            if (wait < next) {
+                next = wait;
+            }
+        }
+        return next;
+    }
+
+private:
+    static const uint8_t none = 0xff;
+
+    static uint8_t slotOf(uint32_t time)
+    {
+        return (time >> TickBits) & (Slots - 1);
+    }
+
+    uint8_t m_heads[Slots];
+    uint8_t m_next[Timers];
+    uint32_t m_deadlines[Timers] = {};
+    bool m_armed[Timers];
+    uint32_t m_last = 0;
+    bool m_started = false;
+};
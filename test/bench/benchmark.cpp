@@ -0,0 +1,239 @@
+// Host benchmarks for the hot paths of ESPReactWifiManager.
+// Every case reports wall time, heap allocations and Serial output per op.
+//
+//   espreact_benchmark [--quick]
+
+#include <ESPReactWifiManager.h>
+#include <ESPAsyncWebServer.h>
+#include <FakePlatform.h>
+
+#include <chrono>
+#include <new>
+
+namespace {
+
+size_t allocations = 0;
+size_t allocatedBytes = 0;
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    allocatedBytes += size;
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace {
+
+size_t iterationScale = 1;
+
+// what tools/generate_assets.py emits for a one-file build
+const char indexPath[] PROGMEM = "/wifi.html";
+const char indexType[] PROGMEM = "text/html";
+const char indexEtag[] PROGMEM = "\"0123456789abcdef\"";
+const uint8_t indexData[1024] PROGMEM = { 0x1f, 0x8b };
+const PortalAsset benchmarkAssets[] PROGMEM = {
+    { indexPath, indexType, indexEtag, indexData, sizeof(indexData), true, false },
+};
+
+// A query for connectivitycheck.gstatic.com with an EDNS record, as Android sends it
+const uint8_t dnsQuery[] = {
+    0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    17, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'v', 'i', 't', 'y', 'c', 'h', 'e', 'c', 'k',
+    7, 'g', 's', 't', 'a', 't', 'i', 'c', 3, 'c', 'o', 'm', 0,
+    0x00, 0x01, 0x00, 0x01,
+    0x00, 0x00, 0x29, 0x05, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+template<typename Setup, typename Operation>
+void run(const char* name, size_t iterations, Setup setup, Operation operation)
+{
+    iterations = std::max<size_t>(1, iterations / iterationScale);
+
+    setup();
+    operation();
+
+    size_t allocationsBefore = allocations;
+    size_t bytesBefore = allocatedBytes;
+    size_t serialBefore = fake::serialBytes();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        operation();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    printf("%-28s %9zu %12.0f %10.1f %12.1f %12.1f\n", name, iterations, ns,
+           double(allocations - allocationsBefore) / iterations,
+           double(allocatedBytes - bytesBefore) / iterations,
+           double(fake::serialBytes() - serialBefore) / iterations);
+}
+
+void generateNetworks(size_t count)
+{
+    std::vector<fake::Network>& networks = fake::wifi().networks;
+    networks.clear();
+    for (size_t i = 0; i < count; ++i) {
+        fake::Network network;
+        // every fourth network is another BSSID of an already seen SSID
+        size_t ssid = i % 4 == 3 ? i / 2 : i;
+        network.ssid = "network-" + std::to_string(ssid);
+        for (size_t b = 0; b < sizeof(network.bssid); ++b) {
+            network.bssid[b] = static_cast<uint8_t>((i >> (b * 8)) + b);
+        }
+        network.rssi = static_cast<int8_t>(-40 - (i * 7) % 55);
+        network.channel = static_cast<uint8_t>(1 + i % 13);
+        network.auth = i % 5 == 0 ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+        networks.push_back(network);
+    }
+}
+
+void runLoopUntil(ESPReactWifiManager& manager, ESPReactWifiManager::ConnectState state)
+{
+    for (int i = 0; i < 100 && manager.connectState() != state; ++i) {
+        manager.loop();
+        fake::advanceMillis(100);
+    }
+    manager.loop();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            iterationScale = 100;
+        }
+    }
+
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    manager.setupHandlers(&server);
+    manager.setApOptions("REACT");
+    manager.setStaOptions("network-1", "password");
+
+    printf("%-28s %9s %12s %10s %12s %12s\n", "benchmark", "iters", "ns/op", "allocs/op", "bytes/op", "serial B/op");
+
+    const size_t scanSizes[] = { 10, 100, 500 };
+    for (size_t size : scanSizes) {
+        char name[32];
+        snprintf(name, sizeof(name), "scan/%zu", size);
+        run(name, 200000 / size, [size]() { generateNetworks(size); }, [&manager]() { manager.scan(); });
+    }
+
+    generateNetworks(100);
+    manager.scan();
+
+    run("wifiList/serve", 20000, []() {}, [&server]() {
+        AsyncWebServerRequest request(HTTP_GET, "/wifiList");
+        server.handle(&request);
+        request.response()->drain();
+    });
+
+    String etag;
+    {
+        AsyncWebServerRequest request(HTTP_GET, "/wifiList");
+        server.handle(&request);
+        etag = request.response()->header("ETag")->value();
+    }
+    run("wifiList/notModified", 20000, []() {}, [&server, &etag]() {
+        AsyncWebServerRequest request(HTTP_GET, "/wifiList");
+        request.setHeader("If-None-Match", etag);
+        server.handle(&request);
+    });
+
+    run("notFound/redirect", 20000, []() {}, [&server]() {
+        AsyncWebServerRequest request(HTTP_GET, "/unknown");
+        request.client()->setLocalIP(IPAddress(8, 8, 8, 8));
+        server.handle(&request);
+    });
+
+    manager.setPortalAssets(benchmarkAssets, 1);
+    run("portal/asset", 20000, []() {}, [&server]() {
+        AsyncWebServerRequest request(HTTP_GET, "/");
+        server.handle(&request);
+        request.response()->drain();
+    });
+
+    manager.startAP();
+    run("captive/probe", 20000, []() {}, [&server]() {
+        AsyncWebServerRequest request(HTTP_GET, "/generate_204");
+        request.client()->setLocalIP(IPAddress(8, 8, 8, 8));
+        server.handle(&request);
+    });
+    if (manager.captiveProbesServed() == 0) {
+        fprintf(stderr, "captive probes were not served by the probe table\n");
+        return 1;
+    }
+
+    // the burst a phone sends right after joining, drained by one loop()
+    run("captive/dnsBurst16", 20000, []() {}, [&manager]() {
+        for (int i = 0; i < 16; ++i) {
+            fake::sendUdp(53, dnsQuery, sizeof(dnsQuery));
+        }
+        manager.loop();
+    });
+    const fake::UdpPacket& reply = fake::udp().lastSent;
+    if (fake::udp().inboundCount != 0 || reply.length != sizeof(dnsQuery) - 11 + 16
+            || reply.data[7] != 1 || IPAddress(reply.data[reply.length - 4], reply.data[reply.length - 3],
+                                                reply.data[reply.length - 2], reply.data[reply.length - 1])
+                    != WiFi.softAPIP()) {
+        fprintf(stderr, "captive DNS did not answer the burst\n");
+        return 1;
+    }
+
+    run("connect/toConnected", 2000, []() {}, [&manager]() {
+        manager.connect();
+        runLoopUntil(manager, ESPReactWifiManager::ConnectState::AwaitingIp);
+        fake::connectStation();
+        manager.loop();
+    });
+
+    manager.setFallbackToAp(false);
+    run("connect/disconnectRetry", 2000, []() {}, [&manager]() {
+        fake::disconnectStation();
+        manager.loop();
+        fake::advanceMillis(5000);
+        runLoopUntil(manager, ESPReactWifiManager::ConnectState::AwaitingIp);
+        fake::connectStation();
+        manager.loop();
+    });
+
+    if (manager.connectState() != ESPReactWifiManager::ConnectState::Connected) {
+        fprintf(stderr, "connect cycle did not end connected\n");
+        return 1;
+    }
+
+    return 0;
+}
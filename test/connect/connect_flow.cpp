@@ -0,0 +1,305 @@
+// Connect flows on the host fake that depend on event timing: the
+// STA_DISCONNECTED the SDK reports for the manager's own WiFi.disconnect(),
+// delivered late, must not count as a failed connect or roam, a cached lease
+// is reused only for its network and within its time, the fallback AP
+// stays up between the retries made from it, also when a rejected password
+// skips the retries, enterprise credentials are saved with the SDK config,
+// and probe answers of hidden networks are marked hidden.
+//
+//   espreact_connect_flow
+
+#include <ESPReactWifiManager.h>
+#include <FakePlatform.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+typedef ESPReactWifiManager::ConnectState ConnectState;
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+void addNetwork(const char* ssid, uint8_t id, int8_t rssi)
+{
+    fake::Network network;
+    network.ssid = ssid;
+    memset(network.bssid, id, sizeof(network.bssid));
+    network.rssi = rssi;
+    network.channel = id;
+    network.auth = WIFI_AUTH_WPA2_PSK;
+    fake::wifi().networks.push_back(network);
+}
+
+bool runUntil(ESPReactWifiManager& manager, ConnectState state, uint32_t maxMs = 30000)
+{
+    for (uint32_t waited = 0; waited < maxMs && manager.connectState() != state; waited += 10) {
+        manager.loop();
+        fake::advanceMillis(10);
+    }
+    return manager.connectState() == state;
+}
+
+void run(ESPReactWifiManager& manager, uint32_t ms)
+{
+    for (uint32_t waited = 0; waited < ms; waited += 10) {
+        manager.loop();
+        fake::advanceMillis(10);
+    }
+}
+
+// settings live in module state and outlast a manager, every flow sets them;
+// the fake is reset before the manager registers its event callbacks
+void setUp(ESPReactWifiManager& manager)
+{
+    addNetwork("home", 6, -55);
+    manager.setFallbackToAp(true);
+    manager.setConnectProbe(false);
+    manager.setFastConnect(false);
+    manager.clearFastConnect();
+    manager.setStaOptions("home", "password");
+}
+
+void fastConnectSurvivesLateLeave()
+{
+    const char* name = "fast connect";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    manager.setFallbackToAp(false);
+    manager.setFastConnect(true);
+
+    manager.connect();
+    expect(runUntil(manager, ConnectState::AwaitingIp), name, "first connect did not begin");
+    fake::connectStation();
+    manager.loop();
+
+    // reconnect from a connected station, the cached channel skips the settle delays
+    fake::wifi().leaveEventDelay = 50;
+    unsigned beginCalls = fake::wifi().beginCalls;
+    manager.connect();
+    expect(runUntil(manager, ConnectState::AwaitingIp), name, "fast connect did not begin");
+    run(manager, 100);
+    expect(fake::wifi().beginCalls == beginCalls + 1, name, "late ASSOC_LEAVE ended the fast connect");
+    expect(fake::wifi().beginChannel == 6, name, "fast connect did not use the cached channel");
+    fake::connectStation();
+    manager.loop();
+    expect(manager.connectState() == ConnectState::Connected, name, "not connected");
+    expect(manager.metrics().disconnects == 0, name, "own disconnect counted");
+}
+
+void roamSurvivesLateLeave()
+{
+    const char* name = "roam";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    manager.setFallbackToAp(false);
+    manager.setStaOptions("mesh", "password");
+    manager.setRoaming(true);
+    addNetwork("mesh", 1, -85);
+    addNetwork("mesh", 2, -60);
+    memset(fake::wifi().connectedBssid, 1, sizeof(fake::wifi().connectedBssid));
+    fake::wifi().rssi = -85;
+
+    manager.connect();
+    expect(runUntil(manager, ConnectState::AwaitingIp), name, "connect did not begin");
+    fake::connectStation();
+    manager.loop();
+
+    // the roam skips the settle delay, the leave of the old BSSID arrives after WiFi.begin()
+    fake::wifi().leaveEventDelay = 50;
+    expect(runUntil(manager, ConnectState::AwaitingIp, 60 * 1000), name, "no roam attempt");
+    run(manager, 100);
+    fake::wifi().rssi = -58;
+    fake::connectStation();
+    run(manager, 100);
+    ESPReactWifiManager::RoamStats stats = manager.roamStats();
+    expect(stats.roams == 1 && stats.failures == 0, name, "late ASSOC_LEAVE failed the roam");
+    expect(fake::wifi().beginBssid[0] == 2, name, "did not roam to the stronger BSSID");
+}
+
+bool reconnect(ESPReactWifiManager& manager)
+{
+    manager.connect();
+    if (!runUntil(manager, ConnectState::AwaitingIp)) {
+        return false;
+    }
+    fake::connectStation();
+    manager.loop();
+    return manager.connectState() == ConnectState::Connected;
+}
+
+void cachedLease()
+{
+    const char* name = "cached lease";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    manager.setFallbackToAp(false);
+    manager.setFastConnect(true, true);
+    addNetwork("office", 11, -50);
+    const IPAddress leased = fake::wifi().localIP;
+
+    expect(reconnect(manager) && !fake::wifi().staticIP, name, "first connect not on DHCP");
+    expect(reconnect(manager) && fake::wifi().staticIP == leased, name, "cached lease not reused");
+
+    // another network must not inherit the cached address
+    manager.setStaOptions("office", "password");
+    expect(reconnect(manager) && !fake::wifi().staticIP, name, "cached address kept for another network");
+
+    // past half of the lease the address is left to DHCP
+    expect(reconnect(manager) && fake::wifi().staticIP == leased, name, "office lease not reused");
+    fake::advanceMillis(fake::wifi().leaseSeconds / 2 * 1000);
+    expect(reconnect(manager) && !fake::wifi().staticIP, name, "expired lease reused");
+}
+
+// fails every attempt that reaches WiFi.begin() with reason, for ms; returns
+// the longest stretch the soft AP was down after it first came up
+uint32_t failAttempts(ESPReactWifiManager& manager, uint8_t reason, uint32_t ms, uint32_t* apUpAt = nullptr)
+{
+    unsigned failedBegin = fake::wifi().beginCalls;
+    uint32_t downSince = 0;
+    uint32_t longestDown = 0;
+    bool apSeen = false;
+    for (uint32_t now = 0; now < ms; now += 10) {
+        manager.loop();
+        if (fake::wifi().beginCalls != failedBegin && manager.connectState() == ConnectState::AwaitingIp) {
+            failedBegin = fake::wifi().beginCalls;
+            fake::disconnectStation(reason);
+        }
+        fake::advanceMillis(10);
+        if (fake::wifi().softAp && !apSeen) {
+            apSeen = true;
+            if (apUpAt) {
+                *apUpAt = now;
+            }
+        }
+        if (apSeen && !fake::wifi().softAp && !downSince) {
+            downSince = now;
+        } else if (fake::wifi().softAp && downSince) {
+            longestDown = std::max(longestDown, now - downSince);
+            downSince = 0;
+        }
+    }
+    return longestDown;
+}
+
+void fallbackApStaysUp()
+{
+    const char* name = "fallback AP";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+
+    manager.connect();
+    uint32_t apUpAt = 0;
+    failAttempts(manager, WIFI_REASON_BEACON_TIMEOUT, 2 * 60 * 1000, &apUpAt);
+    expect(apUpAt > 0, name, "no AP after the retries");
+
+    // from the AP the next attempt waits for the AP retry interval
+    unsigned beginCalls = fake::wifi().beginCalls;
+    uint32_t down = failAttempts(manager, WIFI_REASON_BEACON_TIMEOUT, 55 * 1000);
+    expect(fake::wifi().softAp && down == 0, name, "AP went down within the retry interval");
+    expect(fake::wifi().beginCalls == beginCalls, name, "retried within the retry interval");
+
+    // a retry takes the AP down only for the attempt
+    down = failAttempts(manager, WIFI_REASON_BEACON_TIMEOUT, 3 * 60 * 1000);
+    expect(fake::wifi().beginCalls > beginCalls, name, "no retry from the AP");
+    expect(fake::wifi().softAp && down < 5000, name, "AP not back right after a failed retry");
+
+    // nobody is cut off the portal while using it
+    fake::wifi().apStations = 1;
+    beginCalls = fake::wifi().beginCalls;
+    down = failAttempts(manager, WIFI_REASON_BEACON_TIMEOUT, 5 * 60 * 1000);
+    expect(fake::wifi().beginCalls == beginCalls && down == 0, name, "retried while a client was on the AP");
+}
+
+// a rejected password gives up at once, the AP then waits out the AP retry interval
+void wrongPasswordFallsBackOnce()
+{
+    const char* name = "wrong password";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+
+    manager.connect();
+    uint32_t apUpAt = 0;
+    unsigned beginCalls = fake::wifi().beginCalls;
+    uint32_t down = failAttempts(manager, WIFI_REASON_AUTH_FAIL, 55 * 1000, &apUpAt);
+    expect(apUpAt > 0 && apUpAt < 3000, name, "no AP right after the rejected password");
+    expect(fake::wifi().beginCalls == beginCalls + 1, name, "retried within the retry interval");
+    expect(fake::wifi().softAp && down == 0, name, "AP went down within the retry interval");
+
+    down = failAttempts(manager, WIFI_REASON_AUTH_FAIL, 2 * 60 * 1000);
+    expect(fake::wifi().beginCalls > beginCalls + 1, name, "no retry from the AP");
+    expect(fake::wifi().softAp && down < 5000, name, "AP not back right after a failed retry");
+}
+
+bool probeHidden = false;
+
+// ESP32 scan records carry no hidden flag, a broad scan lists the BSSID without an SSID
+void probeMarksHiddenNetwork()
+{
+    const char* name = "hidden probe";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    manager.setFallbackToAp(false);
+    addNetwork("secret", 11, -60);
+    fake::wifi().networks.back().hidden = true;
+    manager.onProbe([](bool found, const ESPReactWifiManager::WifiRecord& best) {
+        probeHidden = found && best.isHidden;
+    });
+
+    manager.setAsyncScan(true);
+    manager.scan();
+    run(manager, 100);
+    manager.probe("secret");
+    run(manager, 100);
+    expect(probeHidden, name, "hidden network not marked");
+    manager.probe("home");
+    run(manager, 100);
+    expect(!probeHidden, name, "visible network marked hidden");
+}
+
+// the SDK config is all an app relying on setStaOptions() has after a reboot
+void enterpriseCredentialsSaved()
+{
+    const char* name = "enterprise";
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    manager.setFallbackToAp(false);
+    manager.setStaOptions("home", "password", "login");
+
+    manager.connect();
+    expect(runUntil(manager, ConnectState::AwaitingIp), name, "connect did not begin");
+    expect(fake::wifi().savedPassword == "x:login:password", name, "credentials not saved with the SDK config");
+}
+
+} // namespace
+
+int main()
+{
+    fastConnectSurvivesLateLeave();
+    roamSurvivesLateLeave();
+    cachedLease();
+    fallbackApStaysUp();
+    wrongPasswordFallsBackOnce();
+    probeMarksHiddenNetwork();
+    enterpriseCredentialsSaved();
+    if (failures == 0) {
+        printf("connect flows passed\n");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+// CaptiveDns replies: an A query gets the portal address with AA set and RD
+// echoed, AAAA and HTTPS get an empty NOERROR, other opcodes and compressed
+// question names are refused, responses and oversized packets are dropped,
+// EDNS records are not echoed, and truncated queries are never read past
+// their length.
+//
+//   espreact_captive_dns
+
+#include <ESPReactWifiManagerDns.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+const uint8_t portal[4] = { 192, 168, 4, 1 };
+
+CaptiveDns makeDns()
+{
+    CaptiveDns dns;
+    dns.setAddress(portal[0] | (portal[1] << 8) | (portal[2] << 16) | (static_cast<uint32_t>(portal[3]) << 24), 60);
+    return dns;
+}
+
+// header with one question for connectivitycheck.gstatic.com
+std::vector<uint8_t> query(uint16_t type, uint8_t flags = 0x01)
+{
+    const uint8_t packet[] = {
+        0x12, 0x34, flags, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        17, 'c', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'v', 'i', 't', 'y', 'c', 'h', 'e', 'c', 'k',
+        7, 'g', 's', 't', 'a', 't', 'i', 'c', 3, 'c', 'o', 'm', 0,
+        static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type), 0x00, 0x01,
+    };
+    return std::vector<uint8_t>(packet, packet + sizeof(packet));
+}
+
+struct Reply {
+    size_t length;
+    uint8_t data[CaptiveDns::BufferSize];
+
+    uint8_t rcode() const { return data[3] & 0x0f; }
+    uint16_t count(size_t offset) const { return (data[offset] << 8) | data[offset + 1]; }
+};
+
+// answers the first length bytes of packet; the rest of the buffer holds the
+// remaining packet bytes, so reading past length would find a valid query
+Reply answer(const std::vector<uint8_t>& packet, size_t length)
+{
+    Reply reply;
+    memset(reply.data, 0, sizeof(reply.data));
+    memcpy(reply.data, packet.data(), std::min(packet.size(), sizeof(reply.data)));
+    reply.length = makeDns().answer(reply.data, length);
+    return reply;
+}
+
+Reply answer(const std::vector<uint8_t>& packet)
+{
+    return answer(packet, packet.size());
+}
+
+void aQuery()
+{
+    const char* name = "A";
+    std::vector<uint8_t> packet = query(1);
+    Reply reply = answer(packet);
+    expect(reply.length == packet.size() + CaptiveDns::AnswerSize, name, "no answer record");
+    expect(reply.data[0] == 0x12 && reply.data[1] == 0x34, name, "id not kept");
+    expect((reply.data[2] & 0x80) && (reply.data[2] & 0x04), name, "QR or AA not set");
+    expect(reply.data[2] & 0x01, name, "RD not echoed");
+    expect(reply.rcode() == 0 && !(reply.data[3] & 0x80), name, "not NOERROR or RA set");
+    expect(reply.count(4) == 1 && reply.count(6) == 1 && reply.count(8) == 0 && reply.count(10) == 0,
+           name, "wrong section counts");
+    expect(memcmp(reply.data + reply.length - 4, portal, 4) == 0, name, "not the portal address");
+    expect(memcmp(reply.data + 12, packet.data() + 12, packet.size() - 12) == 0, name, "question not echoed");
+
+    reply = answer(query(1, 0x00));
+    expect(!(reply.data[2] & 0x01), name, "RD set without being asked");
+}
+
+void emptyAnswers()
+{
+    const char* name = "AAAA and HTTPS";
+    const uint16_t types[] = { 28, 65 };
+    for (uint16_t type : types) {
+        std::vector<uint8_t> packet = query(type);
+        Reply reply = answer(packet);
+        expect(reply.length == packet.size(), name, "reply is not the question alone");
+        expect(reply.rcode() == 0 && (reply.data[2] & 0x04), name, "not an authoritative NOERROR");
+        expect(reply.count(4) == 1 && reply.count(6) == 0, name, "wrong section counts");
+    }
+}
+
+void refused()
+{
+    const char* name = "refused";
+    // STATUS
+    std::vector<uint8_t> packet = query(1, 0x10 | 0x01);
+    Reply reply = answer(packet);
+    expect(reply.length == 12 && reply.rcode() == 4, name, "other opcode not NOTIMP");
+    expect(((reply.data[2] >> 3) & 0x0f) == 2, name, "opcode not kept");
+    expect(reply.count(4) == 0 && reply.count(6) == 0, name, "NOTIMP with sections");
+
+    // a pointer back to the header instead of the first label
+    packet = query(1);
+    packet[12] = 0xc0;
+    packet[13] = 0x00;
+    reply = answer(packet);
+    expect(reply.length == 12 && reply.rcode() == 1, name, "compressed question not FORMERR");
+
+    packet = query(1);
+    packet[5] = 2;
+    reply = answer(packet);
+    expect(reply.length == 12 && reply.rcode() == 1, name, "two questions not FORMERR");
+
+    packet = query(1, 0x80);
+    expect(answer(packet).length == 0, name, "response answered");
+}
+
+void edns()
+{
+    const char* name = "EDNS";
+    std::vector<uint8_t> packet = query(1);
+    size_t questionEnd = packet.size();
+    packet[11] = 1;
+    const uint8_t opt[] = { 0x00, 0x00, 0x29, 0x05, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    for (uint8_t byte : opt) {
+        packet.push_back(byte);
+    }
+    Reply reply = answer(packet);
+    expect(reply.length == questionEnd + CaptiveDns::AnswerSize, name, "OPT record echoed");
+    expect(reply.count(6) == 1 && reply.count(10) == 0, name, "ARCOUNT not 0");
+    expect(memcmp(reply.data + reply.length - 4, portal, 4) == 0, name, "not the portal address");
+}
+
+void lengths()
+{
+    const char* name = "lengths";
+    std::vector<uint8_t> packet = query(1);
+    for (size_t length = 0; length < packet.size(); ++length) {
+        Reply reply = answer(packet, length);
+        bool ok = length < 12 ? reply.length == 0 : reply.length == 12 && reply.rcode() == 1;
+        if (!ok) {
+            fprintf(stderr, "%s: query cut at %u not refused\n", name, static_cast<unsigned>(length));
+            ++failures;
+            return;
+        }
+    }
+
+    // padded past the largest query
+    packet.resize(CaptiveDns::MaxQuery + 1, 0);
+    expect(answer(packet, packet.size()).length == 0, name, "oversized query answered");
+    expect(answer(packet, CaptiveDns::MaxQuery).length > 0, name, "largest query not answered");
+}
+
+} // namespace
+
+int main()
+{
+    aQuery();
+    emptyAnswers();
+    refused();
+    edns();
+    lengths();
+    if (failures == 0) {
+        printf("captive DNS passed\n");
+    }
+    return failures ? 1 : 0;
+}
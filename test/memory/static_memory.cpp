@@ -0,0 +1,235 @@
+// Steady-state heap use of the ESPREACT_STATIC_MEMORY build: after a warm-up
+// that sizes every buffer once, connect, scan, drop and reconnect, and
+// disconnect cycles must not allocate, with explicit station options and
+// with a known network from the store. Names and credentials are longer than
+// the small string buffer of the host String. A /wifiEvents client receives
+// every event, and /wifiList responses still being sent hold the body a scan
+// would reuse; what the web server itself allocates is not counted.
+//
+//   espreact_static_memory [cycles]
+
+#include <ESPAsyncWebServer.h>
+#include <ESPReactWifiManager.h>
+#include <FakePlatform.h>
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool counting = false;
+size_t allocations = 0;
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    if (counting) {
+        ++allocations;
+    }
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace {
+
+typedef ESPReactWifiManager::ConnectState ConnectState;
+
+const char homeSsid[] = "static-memory-home-network";
+const char homePassword[] = "a passphrase well beyond sso";
+
+// a full scan first, so the warm-up sees the largest result set
+void generateNetworks(std::vector<fake::Network>& networks, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        fake::Network network;
+        network.ssid = i == 0 ? homeSsid : "neighbouring-network-" + std::to_string(i);
+        for (size_t b = 0; b < sizeof(network.bssid); ++b) {
+            network.bssid[b] = static_cast<uint8_t>(i + b);
+        }
+        network.rssi = static_cast<int8_t>(-45 - i);
+        network.channel = static_cast<uint8_t>(1 + i % 13);
+        network.auth = WIFI_AUTH_WPA2_PSK;
+        networks.push_back(network);
+    }
+}
+
+bool runUntil(ESPReactWifiManager& manager, ConnectState state)
+{
+    for (int i = 0; i < 2000 && manager.connectState() != state; ++i) {
+        manager.loop();
+        fake::advanceMillis(10);
+    }
+    return manager.connectState() == state;
+}
+
+AsyncWebServer* server = nullptr;
+// each cycle's /wifiList response is sent to the end of the next cycle
+AsyncWebServerRequest* slowRequest = nullptr;
+
+AsyncWebServerRequest* requestWifiList()
+{
+    bool wasCounting = counting;
+    counting = false;
+    AsyncWebServerRequest* request = new AsyncWebServerRequest(HTTP_GET, "/wifiList");
+    server->handle(request);
+    counting = wasCounting;
+    return request;
+}
+
+void finishRequest(AsyncWebServerRequest* request)
+{
+    bool wasCounting = counting;
+    counting = false;
+    if (request) {
+        request->response()->drain();
+        delete request;
+    }
+    counting = wasCounting;
+}
+
+bool cycle(ESPReactWifiManager& manager)
+{
+    AsyncWebServerRequest* previousRequest = slowRequest;
+    slowRequest = requestWifiList();
+
+    manager.connect();
+    if (!runUntil(manager, ConnectState::AwaitingIp)) {
+        return false;
+    }
+    fake::connectStation();
+    manager.loop();
+
+    // the spare body is still sent by the previous response, the new one waits
+    manager.scan();
+    for (int i = 0; i < 20 && manager.isScanning(); ++i) {
+        manager.loop();
+        fake::advanceMillis(10);
+    }
+    finishRequest(previousRequest);
+
+    // dropped link, reconnect on the backoff schedule
+    fake::disconnectStation(WIFI_REASON_BEACON_TIMEOUT);
+    manager.loop();
+    if (!runUntil(manager, ConnectState::AwaitingIp)) {
+        return false;
+    }
+    fake::connectStation();
+    manager.loop();
+    if (manager.connectState() != ConnectState::Connected) {
+        return false;
+    }
+
+    manager.disconnect();
+    manager.loop();
+    return true;
+}
+
+bool check(const char* name, ESPReactWifiManager& manager, AsyncEventSource* events,
+           std::vector<fake::Network>& other, size_t cycles)
+{
+    // past the success limit of the store, the last write is a warm-up one
+    for (int i = 0; i < 20; ++i) {
+        if (!cycle(manager)) {
+            fprintf(stderr, "%s: warm-up cycle %d did not connect\n", name, i);
+            return false;
+        }
+    }
+
+    size_t total = 0;
+    size_t sent = events->sentCount();
+    for (size_t i = 0; i < cycles; ++i) {
+        // alternate between scan sizes, swapping the fake's list does not allocate
+        fake::wifi().networks.swap(other);
+        allocations = 0;
+        counting = true;
+        bool connected = cycle(manager);
+        counting = false;
+        total += allocations;
+        if (!connected) {
+            fprintf(stderr, "%s: cycle %zu did not connect\n", name, i);
+            return false;
+        }
+    }
+
+    printf("%-24s %6zu cycles %6zu allocations\n", name, cycles, total);
+    // progress, connected, failed and scan events every cycle
+    if (events->sentCount() - sent < cycles * 4) {
+        fprintf(stderr, "%s: events not sent\n", name);
+        return false;
+    }
+    if (total) {
+        fprintf(stderr, "%s: steady-state cycles allocated\n", name);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t cycles = argc > 1 ? strtoul(argv[1], nullptr, 10) : 50;
+
+    fake::reset();
+    std::vector<fake::Network> fewer;
+    generateNetworks(fake::wifi().networks, ESPREACT_WIFI_MAX_RESULTS);
+    generateNetworks(fewer, 4);
+
+    ESPReactWifiManager manager;
+    manager.setAsyncScan(true);
+    manager.setFallbackToAp(false);
+    manager.setHostname("static-memory-test-device");
+    manager.setApOptions("static-memory-test-portal", "portal passphrase");
+
+    AsyncWebServer webServer(80);
+    server = &webServer;
+    manager.setupHandlers(&webServer);
+    AsyncWebServerRequest subscribe(HTTP_GET, "/wifiEvents");
+    AsyncEventSource* events = static_cast<AsyncEventSource*>(webServer.handle(&subscribe));
+    events->setRecording(false);
+
+    manager.setStaOptions(homeSsid, homePassword);
+    if (!check("station options", manager, events, fewer, cycles)) {
+        return 1;
+    }
+
+    manager.addNetwork("another-known-network", "another long passphrase");
+    manager.addNetwork(homeSsid, homePassword);
+    manager.setStaOptions("");
+    if (!check("known networks", manager, events, fewer, cycles)) {
+        return 1;
+    }
+    finishRequest(slowRequest);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+// Host stand-in for the subset of the ESP32 Arduino core the library uses.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class __FlashStringHelper;
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper*>(p))
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define printf_P printf
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strncpy_P strncpy
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t*>(addr))
+
+class String
+{
+public:
+    String() = default;
+    String(const char* cstr) : m_str(cstr ? cstr : "") {}
+    String(const __FlashStringHelper* str) : m_str(reinterpret_cast<const char*>(str)) {}
+    String(const std::string& str) : m_str(str) {}
+    explicit String(char c) : m_str(1, c) {}
+    explicit String(int value) : m_str(std::to_string(value)) {}
+    explicit String(unsigned int value) : m_str(std::to_string(value)) {}
+    explicit String(long value) : m_str(std::to_string(value)) {}
+    explicit String(unsigned long value) : m_str(std::to_string(value)) {}
+
+    const char* c_str() const { return m_str.c_str(); }
+    unsigned int length() const { return m_str.length(); }
+    bool isEmpty() const { return m_str.empty(); }
+    bool reserve(unsigned int size) { m_str.reserve(size); return true; }
+
+    char operator[](unsigned int index) const { return index < m_str.size() ? m_str[index] : 0; }
+    char& operator[](unsigned int index) { return m_str[index]; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    String& operator=(const char* cstr) { m_str = cstr ? cstr : ""; return *this; }
+    String& operator=(const __FlashStringHelper* str) { m_str = reinterpret_cast<const char*>(str); return *this; }
+
+    String& operator+=(const String& rhs) { m_str += rhs.m_str; return *this; }
+    String& operator+=(const char* cstr) { m_str += cstr; return *this; }
+    String& operator+=(const __FlashStringHelper* str) { m_str += reinterpret_cast<const char*>(str); return *this; }
+    String& operator+=(char c) { m_str += c; return *this; }
+    String& operator+=(int value) { m_str += std::to_string(value); return *this; }
+    String& operator+=(unsigned int value) { m_str += std::to_string(value); return *this; }
+    String& operator+=(long value) { m_str += std::to_string(value); return *this; }
+    String& operator+=(unsigned long value) { m_str += std::to_string(value); return *this; }
+    bool concat(const char* cstr, unsigned int length) { m_str.append(cstr, length); return true; }
+
+    friend String operator+(const String& lhs, const String& rhs) { return String(lhs.m_str + rhs.m_str); }
+
+    bool equals(const String& rhs) const { return m_str == rhs.m_str; }
+    bool equalsIgnoreCase(const String& rhs) const
+    {
+        return m_str.size() == rhs.m_str.size()
+                && std::equal(m_str.begin(), m_str.end(), rhs.m_str.begin(), [](char a, char b) {
+                       return tolower(a) == tolower(b);
+                   });
+    }
+    bool operator==(const String& rhs) const { return m_str == rhs.m_str; }
+    bool operator==(const char* rhs) const { return m_str == rhs; }
+    bool operator!=(const String& rhs) const { return m_str != rhs.m_str; }
+    bool operator!=(const char* rhs) const { return m_str != rhs; }
+    bool operator<(const String& rhs) const { return m_str < rhs.m_str; }
+
+    bool startsWith(const String& prefix) const { return m_str.compare(0, prefix.m_str.size(), prefix.m_str) == 0; }
+    bool endsWith(const String& suffix) const
+    {
+        return m_str.size() >= suffix.m_str.size()
+                && m_str.compare(m_str.size() - suffix.m_str.size(), suffix.m_str.size(), suffix.m_str) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const { return find(m_str.find(c, from)); }
+    int indexOf(const String& str, unsigned int from = 0) const { return find(m_str.find(str.m_str, from)); }
+    String substring(unsigned int from) const { return from < m_str.size() ? String(m_str.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        return from < m_str.size() && from < to ? String(m_str.substr(from, to - from)) : String();
+    }
+    long toInt() const { return strtol(m_str.c_str(), nullptr, 10); }
+
+private:
+    static int find(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+    std::string m_str;
+};
+
+class IPAddress
+{
+public:
+    IPAddress() : m_address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : m_address(a | (b << 8) | (c << 16) | (static_cast<uint32_t>(d) << 24)) {}
+    IPAddress(uint32_t address) : m_address(address) {}
+
+    operator uint32_t() const { return m_address; }
+    bool operator==(const IPAddress& rhs) const { return m_address == rhs.m_address; }
+    bool operator!=(const IPAddress& rhs) const { return m_address != rhs.m_address; }
+    uint8_t operator[](int index) const { return (m_address >> (index * 8)) & 0xff; }
+
+    String toString() const
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(buffer);
+    }
+
+private:
+    uint32_t m_address;
+};
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t print(const char* str) { return write(reinterpret_cast<const uint8_t*>(str), strlen(str)); }
+    size_t print(const __FlashStringHelper* str) { return print(reinterpret_cast<const char*>(str)); }
+    size_t print(const String& str) { return print(str.c_str()); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(const IPAddress& ip) { return print(ip.toString()); }
+
+    size_t println() { return print("\r\n"); }
+    template<typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0) {
+            return 0;
+        }
+        return write(reinterpret_cast<const uint8_t*>(buffer),
+                     std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+    }
+};
+
+class HardwareSerial : public Print
+{
+public:
+    using Print::write;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    void begin(unsigned long) {}
+    void flush() {}
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+    void restart();
+    uint32_t getFreeHeap();
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
@@ -0,0 +1,280 @@
+#pragma once
+
+// Host stand-in for the parts of ESPAsyncWebServer the library uses.
+// Requests are dispatched synchronously by AsyncWebServer::handle() and the
+// response body is pulled with AsyncWebServerResponse::drain().
+
+#include <Arduino.h>
+
+typedef enum {
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String& filename, size_t index,
+                           uint8_t* data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                           size_t index, size_t total)> ArBodyHandlerFunction;
+typedef std::function<size_t(uint8_t* buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<String(const String&)> AwsTemplateProcessor;
+
+class AsyncWebHeader
+{
+public:
+    AsyncWebHeader(const String& name, const String& value) : m_name(name), m_value(value) {}
+    const String& name() const { return m_name; }
+    const String& value() const { return m_value; }
+
+private:
+    String m_name;
+    String m_value;
+};
+
+class AsyncWebParameter
+{
+public:
+    AsyncWebParameter(const String& name, const String& value, bool post = false)
+        : m_name(name), m_value(value), m_post(post) {}
+    const String& name() const { return m_name; }
+    const String& value() const { return m_value; }
+    bool isPost() const { return m_post; }
+    bool isFile() const { return false; }
+
+private:
+    String m_name;
+    String m_value;
+    bool m_post;
+};
+
+class AsyncClient
+{
+public:
+    IPAddress localIP() const { return m_localIP; }
+    IPAddress remoteIP() const { return m_remoteIP; }
+    void setLocalIP(const IPAddress& ip) { m_localIP = ip; }
+    void setRemoteIP(const IPAddress& ip) { m_remoteIP = ip; }
+
+private:
+    IPAddress m_localIP;
+    IPAddress m_remoteIP;
+};
+
+class AsyncWebServerResponse
+{
+public:
+    AsyncWebServerResponse(int code, const String& contentType, size_t contentLength,
+                           AwsResponseFiller filler, bool chunked = false);
+    virtual ~AsyncWebServerResponse() = default;
+
+    void addHeader(const String& name, const String& value);
+    void setCode(int code) { m_code = code; }
+    void setContentLength(size_t len) { m_contentLength = len; }
+
+    // test side
+    int code() const { return m_code; }
+    const String& contentType() const { return m_contentType; }
+    size_t contentLength() const { return m_contentLength; }
+    bool chunked() const { return m_chunked; }
+    const AsyncWebHeader* header(const char* name) const;
+    // pulls the body through the filler in chunks of at most maxLen bytes
+    String drain(size_t maxLen = 1436, size_t* chunks = nullptr);
+    // pulls one chunk at index, for tests that interleave a response
+    String fill(size_t index, size_t maxLen = 1436);
+
+private:
+    int m_code;
+    String m_contentType;
+    size_t m_contentLength;
+    AwsResponseFiller m_filler;
+    bool m_chunked;
+    std::vector<AsyncWebHeader> m_headers;
+};
+
+class AsyncWebServerRequest
+{
+public:
+    AsyncWebServerRequest(WebRequestMethodComposite method, const String& url);
+    ~AsyncWebServerRequest();
+
+    WebRequestMethodComposite method() const { return m_method; }
+    const String& url() const { return m_url; }
+    AsyncClient* client() { return &m_client; }
+    const String& contentType() const { return m_contentType; }
+    size_t contentLength() const { return m_body.length(); }
+
+    void addInterestingHeader(const String& name);
+    bool hasHeader(const String& name) const;
+    AsyncWebHeader* getHeader(const String& name) const;
+
+    size_t args() const { return m_params.size(); }
+    const String& arg(size_t i) const;
+    const String& arg(const String& name) const;
+    const String& argName(size_t i) const;
+    bool hasArg(const char* name) const;
+    size_t params() const { return m_params.size(); }
+    AsyncWebParameter* getParam(size_t i) const;
+    bool hasParam(const String& name, bool post = false, bool file = false) const;
+    AsyncWebParameter* getParam(const String& name, bool post = false, bool file = false) const;
+
+    AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(),
+                                          const String& content = String());
+    AsyncWebServerResponse* beginResponse(const String& contentType, size_t len,
+                                          AwsResponseFiller callback,
+                                          AwsTemplateProcessor templateCallback = nullptr);
+    AsyncWebServerResponse* beginResponse_P(int code, const String& contentType,
+                                            const uint8_t* content, size_t len,
+                                            AwsTemplateProcessor callback = nullptr);
+    AsyncWebServerResponse* beginResponse_P(int code, const String& contentType, PGM_P content,
+                                            AwsTemplateProcessor callback = nullptr);
+    AsyncWebServerResponse* beginChunkedResponse(const String& contentType,
+                                                 AwsResponseFiller callback,
+                                                 AwsTemplateProcessor templateCallback = nullptr);
+
+    void send(AsyncWebServerResponse* response);
+    void send(int code, const String& contentType = String(), const String& content = String());
+    void send_P(int code, const String& contentType, const uint8_t* content, size_t len);
+    void send_P(int code, const String& contentType, PGM_P content);
+    void redirect(const String& url);
+
+    void* _tempObject = nullptr;
+
+    // test side
+    void setHeader(const String& name, const String& value);
+    void addParam(const String& name, const String& value, bool post = false);
+    void setBody(const String& contentType, const String& body);
+    const String& body() const { return m_body; }
+    AsyncWebServerResponse* response() const { return m_response; }
+    // like the real server, keeps only headers some handler asked for
+    void removeNotInterestingHeaders();
+
+private:
+    WebRequestMethodComposite m_method;
+    String m_url;
+    String m_contentType;
+    String m_body;
+    AsyncClient m_client;
+    std::vector<AsyncWebHeader*> m_headers;
+    std::vector<String> m_interestingHeaders;
+    std::vector<AsyncWebParameter*> m_params;
+    AsyncWebServerResponse* m_response = nullptr;
+};
+
+class AsyncWebHandler
+{
+public:
+    virtual ~AsyncWebHandler() = default;
+    virtual bool canHandle(AsyncWebServerRequest* request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest* request) {}
+    virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                            size_t index, size_t total) {}
+    virtual bool isRequestHandlerTrivial() { return true; }
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler
+{
+public:
+    AsyncCallbackWebHandler(const String& uri, WebRequestMethodComposite method,
+                            ArRequestHandlerFunction onRequest, ArBodyHandlerFunction onBody)
+        : m_uri(uri), m_method(method), m_onRequest(onRequest), m_onBody(onBody) {}
+
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                    size_t index, size_t total) override;
+    bool isRequestHandlerTrivial() override { return !m_onBody; }
+
+private:
+    String m_uri;
+    WebRequestMethodComposite m_method;
+    ArRequestHandlerFunction m_onRequest;
+    ArBodyHandlerFunction m_onBody;
+};
+
+class AsyncEventSource;
+
+class AsyncEventSourceClient
+{
+public:
+    explicit AsyncEventSourceClient(AsyncEventSource* source) : m_source(source) {}
+    void send(const char* message, const char* event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+    bool connected() const { return true; }
+
+private:
+    AsyncEventSource* m_source;
+};
+
+typedef std::function<void(AsyncEventSourceClient* client)> ArEventHandlerFunction;
+
+// Requests to the event URL add a client; everything sent to the source or
+// to one of its clients is recorded instead of written to a socket.
+class AsyncEventSource : public AsyncWebHandler
+{
+public:
+    explicit AsyncEventSource(const String& url) : m_url(url) {}
+    ~AsyncEventSource() override;
+
+    void onConnect(ArEventHandlerFunction callback) { m_connect = callback; }
+    void send(const char* message, const char* event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+    size_t count() const { return m_clients.size(); }
+
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+
+    // test side
+    struct Message {
+        String event;
+        String data;
+    };
+    const std::vector<Message>& sent() const { return m_sent; }
+    void clearSent() { m_sent.clear(); }
+    // false only counts messages, for tests that watch the heap
+    void setRecording(bool recording) { m_recording = recording; }
+    size_t sentCount() const { return m_sentCount; }
+    void record(const char* message, const char* event);
+
+private:
+    String m_url;
+    ArEventHandlerFunction m_connect;
+    std::vector<AsyncEventSourceClient*> m_clients;
+    std::vector<Message> m_sent;
+    bool m_recording = true;
+    size_t m_sentCount = 0;
+};
+
+class AsyncWebServer
+{
+public:
+    explicit AsyncWebServer(uint16_t port) {}
+    ~AsyncWebServer();
+
+    void begin() {}
+    AsyncWebHandler& addHandler(AsyncWebHandler* handler);
+    bool removeHandler(AsyncWebHandler* handler);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method,
+                                ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method,
+                                ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload,
+                                ArBodyHandlerFunction onBody = nullptr);
+    void onNotFound(ArRequestHandlerFunction fn) { m_notFound = fn; }
+
+    // test side: routes the request like the real server, body included;
+    // returns the handler that took it, nullptr for the not found handler
+    AsyncWebHandler* handle(AsyncWebServerRequest* request);
+
+private:
+    std::vector<AsyncWebHandler*> m_handlers;
+    ArRequestHandlerFunction m_notFound;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace fs {
+
+struct FileData;
+
+class File
+{
+public:
+    File() = default;
+    File(std::shared_ptr<FileData> data, bool write);
+
+    explicit operator bool() const { return static_cast<bool>(m_data); }
+    size_t read(uint8_t* buffer, size_t size);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t size() const;
+    void close();
+
+private:
+    std::shared_ptr<FileData> m_data;
+    size_t m_position = 0;
+    bool m_write = false;
+};
+
+class FS
+{
+public:
+    File open(const char* path, const char* mode = "r");
+    File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool begin(bool formatOnFail = false) { return true; }
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
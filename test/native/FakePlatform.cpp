@@ -0,0 +1,1126 @@
+#include <FakePlatform.h>
+
+#include <ESPAsyncWebServer.h>
+#include <SPIFFS.h>
+#include <Ticker.h>
+#include <WiFiUdp.h>
+#include <esp_wpa2.h>
+#include <lwip/dhcp.h>
+
+#include <atomic>
+#include <map>
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+fs::FS SPIFFS;
+
+namespace {
+
+// advanced by the test while a manager task may be reading it
+std::atomic<uint32_t> currentMillis { 0 };
+bool serialEcho = false;
+size_t serialWritten = 0;
+
+fake::WiFiState state;
+fake::UdpState udpState;
+std::vector<WiFiEventCb> eventCallbacks;
+std::vector<WiFiEventSysCb> sysEventCallbacks;
+std::vector<Ticker*> tickers;
+
+int statusBits = 0;
+uint32_t scanStarted = 0;
+uint8_t scanChannel = 0;
+std::string scanSsid;
+// hidden networks are listed without their SSID, unless left out
+bool scanShowHidden = false;
+std::vector<wifi_ap_record_t> scanRecords;
+
+uint32_t randomState = 0x9e3779b9;
+
+// ASSOC_LEAVE of a WiFi.disconnect(), see WiFiState::leaveEventDelay
+bool leaveEventPending = false;
+uint32_t leaveEventAt = 0;
+
+void fillScanRecords()
+{
+    scanRecords.clear();
+    for (const fake::Network& network : state.networks) {
+        if (scanChannel != 0 && network.channel != scanChannel) {
+            continue;
+        }
+        if (!scanSsid.empty() && network.ssid != scanSsid) {
+            continue;
+        }
+        if (network.hidden && scanSsid.empty() && !scanShowHidden) {
+            continue;
+        }
+        wifi_ap_record_t record;
+        memset(&record, 0, sizeof(record));
+        memcpy(record.bssid, network.bssid, sizeof(record.bssid));
+        if (!network.hidden || !scanSsid.empty()) {
+            strncpy(reinterpret_cast<char*>(record.ssid), network.ssid.c_str(), sizeof(record.ssid) - 1);
+        }
+        record.primary = network.channel;
+        record.rssi = network.rssi;
+        record.authmode = network.auth;
+        scanRecords.push_back(record);
+    }
+}
+
+void startScan(uint8_t channel, const char* ssid = nullptr, bool showHidden = false)
+{
+    ++state.scansStarted;
+    if (ssid) {
+        ++state.directedScans;
+    }
+    state.lastScanSsid = ssid ? ssid : "";
+    scanSsid = state.lastScanSsid;
+    scanChannel = channel;
+    scanShowHidden = showHidden;
+    scanStarted = currentMillis;
+    scanRecords.clear();
+    statusBits &= ~WIFI_SCAN_DONE_BIT;
+    statusBits |= WIFI_SCANNING_BIT;
+}
+
+} // namespace
+
+namespace fake {
+
+void reset()
+{
+    state = WiFiState();
+    udpState.boundPort = 0;
+    udpState.inboundHead = 0;
+    udpState.inboundCount = 0;
+    udpState.sent = 0;
+    eventCallbacks.clear();
+    sysEventCallbacks.clear();
+    statusBits = 0;
+    scanRecords.clear();
+    leaveEventPending = false;
+    currentMillis = 0;
+}
+
+WiFiState& wifi()
+{
+    return state;
+}
+
+UdpState& udp()
+{
+    return udpState;
+}
+
+bool sendUdp(uint16_t port, const uint8_t* data, size_t length, IPAddress from, uint16_t fromPort)
+{
+    if (udpState.boundPort != port || udpState.inboundCount == UdpState::Capacity
+            || length > sizeof(UdpPacket::data)) {
+        return false;
+    }
+    UdpPacket& packet = udpState.inbound[(udpState.inboundHead + udpState.inboundCount++) % UdpState::Capacity];
+    packet.remoteIP = from;
+    packet.remotePort = fromPort;
+    packet.length = length;
+    memcpy(packet.data, data, length);
+    return true;
+}
+
+void setMillis(uint32_t now)
+{
+    currentMillis = now;
+}
+
+void advanceMillis(uint32_t ms)
+{
+    currentMillis += ms;
+    if (leaveEventPending && currentMillis - leaveEventAt < 0x80000000u) {
+        leaveEventPending = false;
+        emitEvent(SYSTEM_EVENT_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+    }
+    std::vector<Ticker*> due = tickers;
+    for (Ticker* ticker : due) {
+        ticker->fireIfDue(currentMillis);
+    }
+}
+
+void emitEvent(system_event_id_t event, uint8_t reason)
+{
+    for (WiFiEventCb callback : eventCallbacks) {
+        callback(event);
+    }
+    system_event_t info = {};
+    info.event_id = event;
+    if (event == SYSTEM_EVENT_STA_DISCONNECTED) {
+        info.event_info.disconnected.reason = reason;
+    }
+    for (WiFiEventSysCb callback : sysEventCallbacks) {
+        callback(&info);
+    }
+}
+
+void connectStation()
+{
+    state.status = WL_CONNECTED;
+    if (state.beginChannel) {
+        state.connectedChannel = state.beginChannel;
+    }
+    if (state.beginBssidSet) {
+        memcpy(state.connectedBssid, state.beginBssid, sizeof(state.connectedBssid));
+    }
+    if (state.staticIP) {
+        state.localIP = state.staticIP;
+    }
+    emitEvent(SYSTEM_EVENT_STA_CONNECTED);
+    emitEvent(SYSTEM_EVENT_STA_GOT_IP);
+}
+
+void disconnectStation(uint8_t reason)
+{
+    state.status = WL_DISCONNECTED;
+    emitEvent(SYSTEM_EVENT_STA_DISCONNECTED, reason);
+}
+
+void setSerialEcho(bool echo)
+{
+    serialEcho = echo;
+}
+
+size_t serialBytes()
+{
+    return serialWritten;
+}
+
+} // namespace fake
+
+// Arduino core
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    serialWritten += size;
+    if (serialEcho) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+void EspClass::restart()
+{
+    ++state.restarts;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return 200 * 1024;
+}
+
+uint32_t EspClass::getMaxAllocHeap()
+{
+    return 110 * 1024;
+}
+
+uint32_t millis()
+{
+    return currentMillis;
+}
+
+uint32_t micros()
+{
+    return currentMillis * 1000;
+}
+
+void delay(uint32_t ms)
+{
+    fake::advanceMillis(ms);
+}
+
+void yield()
+{
+}
+
+long random(long howbig)
+{
+    if (howbig <= 0) {
+        return 0;
+    }
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+    return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+// Ticker
+
+void Ticker::once(float seconds, callback_t callback)
+{
+    once_ms(static_cast<uint32_t>(seconds * 1000), callback);
+}
+
+void Ticker::once_ms(uint32_t milliseconds, callback_t callback)
+{
+    detach();
+    m_callback = callback;
+    m_deadline = currentMillis + milliseconds;
+    tickers.push_back(this);
+}
+
+void Ticker::detach()
+{
+    m_callback = nullptr;
+    tickers.erase(std::remove(tickers.begin(), tickers.end(), this), tickers.end());
+}
+
+void Ticker::fireIfDue(uint32_t now)
+{
+    if (m_callback && static_cast<int32_t>(now - m_deadline) >= 0) {
+        callback_t callback = m_callback;
+        detach();
+        callback();
+    }
+}
+
+// WiFiUDP
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    if (udpState.boundPort != 0) {
+        return 0;
+    }
+    udpState.boundPort = port;
+    m_bound = true;
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    if (m_bound) {
+        udpState.boundPort = 0;
+        udpState.inboundCount = 0;
+        m_bound = false;
+    }
+    m_rxLength = m_rxPosition = 0;
+}
+
+int WiFiUDP::parsePacket()
+{
+    m_rxLength = m_rxPosition = 0;
+    if (!m_bound || udpState.inboundCount == 0) {
+        return 0;
+    }
+    const fake::UdpPacket& packet = udpState.inbound[udpState.inboundHead];
+    udpState.inboundHead = (udpState.inboundHead + 1) % fake::UdpState::Capacity;
+    --udpState.inboundCount;
+    m_remoteIP = packet.remoteIP;
+    m_remotePort = packet.remotePort;
+    m_rxLength = packet.length;
+    memcpy(m_rx, packet.data, packet.length);
+    return m_rxLength;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t len)
+{
+    size_t count = std::min<size_t>(len, available());
+    memcpy(buffer, m_rx + m_rxPosition, count);
+    m_rxPosition += count;
+    return count;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    m_txIP = ip;
+    m_txPort = port;
+    m_txLength = 0;
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size)
+{
+    size_t count = std::min(size, sizeof(m_tx) - m_txLength);
+    memcpy(m_tx + m_txLength, buffer, count);
+    m_txLength += count;
+    return count;
+}
+
+int WiFiUDP::endPacket()
+{
+    fake::UdpPacket& packet = udpState.lastSent;
+    packet.remoteIP = m_txIP;
+    packet.remotePort = m_txPort;
+    packet.length = m_txLength;
+    memcpy(packet.data, m_tx, m_txLength);
+    ++udpState.sent;
+    return 1;
+}
+
+// SPIFFS
+
+namespace fs {
+
+struct FileData {
+    std::vector<uint8_t> bytes;
+};
+
+namespace {
+std::map<std::string, std::shared_ptr<FileData>> files;
+}
+
+File::File(std::shared_ptr<FileData> data, bool write) : m_data(data), m_write(write)
+{
+}
+
+size_t File::read(uint8_t* buffer, size_t size)
+{
+    if (!m_data || m_write) {
+        return 0;
+    }
+    size_t length = std::min(size, m_data->bytes.size() - m_position);
+    memcpy(buffer, m_data->bytes.data() + m_position, length);
+    m_position += length;
+    return length;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size)
+{
+    if (!m_data || !m_write) {
+        return 0;
+    }
+    m_data->bytes.insert(m_data->bytes.end(), buffer, buffer + size);
+    return size;
+}
+
+size_t File::size() const
+{
+    return m_data ? m_data->bytes.size() : 0;
+}
+
+void File::close()
+{
+    m_data.reset();
+}
+
+File FS::open(const char* path, const char* mode)
+{
+    if (mode[0] == 'w') {
+        std::shared_ptr<FileData> data = std::make_shared<FileData>();
+        files[path] = data;
+        return File(data, true);
+    }
+    if (mode[0] == 'a') {
+        std::shared_ptr<FileData>& data = files[path];
+        if (!data) {
+            data = std::make_shared<FileData>();
+        }
+        return File(data, true);
+    }
+    auto it = files.find(path);
+    return it == files.end() ? File() : File(it->second, false);
+}
+
+bool FS::exists(const char* path)
+{
+    return files.count(path) > 0;
+}
+
+bool FS::remove(const char* path)
+{
+    return files.erase(path) > 0;
+}
+
+} // namespace fs
+
+// ESP-IDF
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t* conf)
+{
+    memset(conf, 0, sizeof(*conf));
+    strncpy(reinterpret_cast<char*>(conf->sta.ssid), state.savedSsid.c_str(), sizeof(conf->sta.ssid));
+    strncpy(reinterpret_cast<char*>(conf->sta.password), state.savedPassword.c_str(), sizeof(conf->sta.password));
+    return ESP_OK;
+}
+
+// lwIP
+
+struct netif {
+    struct dhcp dhcp;
+};
+
+namespace {
+
+struct netif stationNetif;
+
+} // namespace
+
+struct netif* netif_default = &stationNetif;
+
+struct dhcp* netif_dhcp_data(struct netif* netif)
+{
+    // a static address has no DHCP client
+    netif->dhcp.offered_t0_lease = state.staticIP ? 0 : state.leaseSeconds;
+    return &netif->dhcp;
+}
+
+esp_err_t esp_wifi_get_country(wifi_country_t* country)
+{
+    memset(country, 0, sizeof(*country));
+    memcpy(country->cc, "01", 3);
+    country->schan = 1;
+    country->nchan = 13;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t* config, bool block)
+{
+    startScan(config ? config->channel : 0,
+              config && config->ssid ? reinterpret_cast<const char*>(config->ssid) : nullptr,
+              config && config->show_hidden);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_wpa2_ent_enable(const esp_wpa2_config_t* config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_wpa2_ent_set_identity(const unsigned char* identity, int len)
+{
+    state.enterpriseIdentity.assign(reinterpret_cast<const char*>(identity), len);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_wpa2_ent_set_username(const unsigned char* username, int len)
+{
+    state.enterpriseUsername.assign(reinterpret_cast<const char*>(username), len);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_wpa2_ent_set_password(const unsigned char* password, int len)
+{
+    state.enterprisePassword.assign(reinterpret_cast<const char*>(password), len);
+    return ESP_OK;
+}
+
+// WiFi
+
+int WiFiGenericClass::getStatusBits()
+{
+    return statusBits;
+}
+
+int WiFiGenericClass::setStatusBits(int bits)
+{
+    statusBits |= bits;
+    return statusBits;
+}
+
+int WiFiGenericClass::clearStatusBits(int bits)
+{
+    statusBits &= ~bits;
+    return statusBits;
+}
+
+int16_t WiFiScanClass::scanNetworks(bool async, bool show_hidden, bool passive, uint32_t max_ms_per_chan)
+{
+    startScan(0, nullptr, show_hidden);
+    if (async) {
+        return WIFI_SCAN_RUNNING;
+    }
+    return scanComplete();
+}
+
+int16_t WiFiScanClass::scanComplete()
+{
+    if (statusBits & WIFI_SCANNING_BIT) {
+        if (currentMillis - scanStarted < state.scanDuration) {
+            return WIFI_SCAN_RUNNING;
+        }
+        fillScanRecords();
+        statusBits &= ~WIFI_SCANNING_BIT;
+        statusBits |= WIFI_SCAN_DONE_BIT;
+    }
+    if (statusBits & WIFI_SCAN_DONE_BIT) {
+        return static_cast<int16_t>(scanRecords.size());
+    }
+    return WIFI_SCAN_FAILED;
+}
+
+void WiFiScanClass::scanDelete()
+{
+    scanRecords.clear();
+    statusBits &= ~WIFI_SCAN_DONE_BIT;
+}
+
+uint8_t WiFiScanClass::encryptionType(uint8_t networkItem)
+{
+    return networkItem < scanRecords.size() ? scanRecords[networkItem].authmode : WIFI_AUTH_MAX;
+}
+
+String WiFiScanClass::SSID(uint8_t networkItem)
+{
+    return networkItem < scanRecords.size()
+            ? String(reinterpret_cast<const char*>(scanRecords[networkItem].ssid))
+            : String();
+}
+
+void* WiFiScanClass::_getScanInfoByIndex(int i)
+{
+    return i >= 0 && static_cast<size_t>(i) < scanRecords.size() ? &scanRecords[i] : nullptr;
+}
+
+int WiFiClass::onEvent(WiFiEventCb callback, system_event_id_t event)
+{
+    eventCallbacks.push_back(callback);
+    return static_cast<int>(eventCallbacks.size());
+}
+
+int WiFiClass::onEvent(WiFiEventSysCb callback, system_event_id_t event)
+{
+    sysEventCallbacks.push_back(callback);
+    return static_cast<int>(eventCallbacks.size() + sysEventCallbacks.size());
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+    state.mode = mode;
+    if (mode != WIFI_MODE_AP && mode != WIFI_MODE_APSTA) {
+        state.softAp = false;
+    }
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode()
+{
+    return state.mode;
+}
+
+wl_status_t WiFiClass::status()
+{
+    return state.status;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel,
+                             const uint8_t* bssid, bool connect)
+{
+    ++state.beginCalls;
+    state.beginSsid = ssid;
+    state.beginPassword = passphrase ? passphrase : "";
+    state.beginChannel = channel;
+    state.beginBssidSet = bssid != nullptr;
+    if (bssid) {
+        memcpy(state.beginBssid, bssid, sizeof(state.beginBssid));
+    }
+    state.savedSsid = state.beginSsid;
+    state.savedPassword = state.beginPassword;
+    state.status = WL_DISCONNECTED;
+    return state.status;
+}
+
+bool WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2)
+{
+    state.staticIP = local_ip;
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap)
+{
+    bool connected = state.status == WL_CONNECTED;
+    state.status = WL_DISCONNECTED;
+    if (connected && state.leaveEventDelay) {
+        leaveEventPending = true;
+        leaveEventAt = currentMillis + state.leaveEventDelay;
+    } else if (connected) {
+        fake::emitEvent(SYSTEM_EVENT_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+    }
+    return true;
+}
+
+bool WiFiClass::setHostname(const char* hostname)
+{
+    return true;
+}
+
+IPAddress WiFiClass::localIP()
+{
+    return state.status == WL_CONNECTED ? state.localIP : IPAddress();
+}
+
+IPAddress WiFiClass::gatewayIP()
+{
+    return state.gatewayIP;
+}
+
+IPAddress WiFiClass::subnetMask()
+{
+    return state.subnetMask;
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t dns_no)
+{
+    return dns_no == 0 ? state.dnsIP : IPAddress();
+}
+
+String WiFiClass::SSID() const
+{
+    return String(state.beginSsid);
+}
+
+uint8_t* WiFiClass::BSSID()
+{
+    return state.connectedBssid;
+}
+
+String WiFiClass::BSSIDstr()
+{
+    char buffer[18];
+    snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X",
+             state.connectedBssid[0], state.connectedBssid[1], state.connectedBssid[2],
+             state.connectedBssid[3], state.connectedBssid[4], state.connectedBssid[5]);
+    return String(buffer);
+}
+
+int32_t WiFiClass::channel()
+{
+    return state.connectedChannel;
+}
+
+int8_t WiFiClass::RSSI()
+{
+    return state.status == WL_CONNECTED ? state.rssi : 0;
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac)
+{
+    memcpy(mac, state.mac, sizeof(state.mac));
+    return mac;
+}
+
+bool WiFiClass::softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet)
+{
+    return true;
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* passphrase, int channel, int ssid_hidden, int max_connection)
+{
+    state.softAp = true;
+    return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifioff)
+{
+    state.softAp = false;
+    state.apStations = 0;
+    // like the core, wifioff drops the AP from the mode
+    if (wifioff && state.mode == WIFI_MODE_APSTA) {
+        state.mode = WIFI_MODE_STA;
+    } else if (wifioff && state.mode == WIFI_MODE_AP) {
+        state.mode = WIFI_MODE_NULL;
+    }
+    return true;
+}
+
+uint8_t WiFiClass::softAPgetStationNum()
+{
+    return state.apStations;
+}
+
+IPAddress WiFiClass::softAPIP()
+{
+    return state.softAp ? IPAddress(8, 8, 8, 8) : IPAddress();
+}
+
+void WiFiClass::printDiag(Print& dest)
+{
+}
+
+// ESPAsyncWebServer
+
+AsyncWebServerResponse::AsyncWebServerResponse(int code, const String& contentType, size_t contentLength,
+                                               AwsResponseFiller filler, bool chunked)
+    : m_code(code)
+    , m_contentType(contentType)
+    , m_contentLength(contentLength)
+    , m_filler(filler)
+    , m_chunked(chunked)
+{
+}
+
+void AsyncWebServerResponse::addHeader(const String& name, const String& value)
+{
+    m_headers.emplace_back(name, value);
+}
+
+const AsyncWebHeader* AsyncWebServerResponse::header(const char* name) const
+{
+    for (const AsyncWebHeader& header : m_headers) {
+        if (header.name().equalsIgnoreCase(name)) {
+            return &header;
+        }
+    }
+    return nullptr;
+}
+
+String AsyncWebServerResponse::drain(size_t maxLen, size_t* chunks)
+{
+    String body;
+    if (chunks) {
+        *chunks = 0;
+    }
+    if (!m_filler) {
+        return body;
+    }
+
+    std::vector<uint8_t> buffer(maxLen);
+    size_t index = 0;
+    while (m_chunked || index < m_contentLength) {
+        size_t len = m_filler(buffer.data(), maxLen, index);
+        if (len == 0 || len > maxLen) {
+            break;
+        }
+        body.concat(reinterpret_cast<const char*>(buffer.data()), len);
+        index += len;
+        if (chunks) {
+            ++*chunks;
+        }
+    }
+    return body;
+}
+
+String AsyncWebServerResponse::fill(size_t index, size_t maxLen)
+{
+    String chunk;
+    if (!m_filler || (!m_chunked && index >= m_contentLength)) {
+        return chunk;
+    }
+    std::vector<uint8_t> buffer(maxLen);
+    size_t len = m_filler(buffer.data(), maxLen, index);
+    if (len <= maxLen) {
+        chunk.concat(reinterpret_cast<const char*>(buffer.data()), len);
+    }
+    return chunk;
+}
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String& url)
+    : m_method(method), m_url(url)
+{
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest()
+{
+    for (AsyncWebHeader* header : m_headers) {
+        delete header;
+    }
+    for (AsyncWebParameter* param : m_params) {
+        delete param;
+    }
+    delete m_response;
+    // like the real server, handlers keep per-request state here
+    free(_tempObject);
+}
+
+void AsyncWebServerRequest::addInterestingHeader(const String& name)
+{
+    m_interestingHeaders.push_back(name);
+}
+
+bool AsyncWebServerRequest::hasHeader(const String& name) const
+{
+    return getHeader(name) != nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const
+{
+    for (AsyncWebHeader* header : m_headers) {
+        if (header->name().equalsIgnoreCase(name)) {
+            return header;
+        }
+    }
+    return nullptr;
+}
+
+const String& AsyncWebServerRequest::arg(size_t i) const
+{
+    static const String empty;
+    return i < m_params.size() ? m_params[i]->value() : empty;
+}
+
+const String& AsyncWebServerRequest::arg(const String& name) const
+{
+    static const String empty;
+    AsyncWebParameter* param = getParam(name, true);
+    if (!param) {
+        param = getParam(name, false);
+    }
+    return param ? param->value() : empty;
+}
+
+const String& AsyncWebServerRequest::argName(size_t i) const
+{
+    static const String empty;
+    return i < m_params.size() ? m_params[i]->name() : empty;
+}
+
+bool AsyncWebServerRequest::hasArg(const char* name) const
+{
+    return getParam(name, true) || getParam(name, false);
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(size_t i) const
+{
+    return i < m_params.size() ? m_params[i] : nullptr;
+}
+
+bool AsyncWebServerRequest::hasParam(const String& name, bool post, bool file) const
+{
+    return getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) const
+{
+    for (AsyncWebParameter* param : m_params) {
+        if (param->name() == name && param->isPost() == post) {
+            return param;
+        }
+    }
+    return nullptr;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType,
+                                                             const String& content)
+{
+    std::shared_ptr<String> body = std::make_shared<String>(content);
+    return new AsyncWebServerResponse(code, contentType, body->length(),
+        [body](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t len = std::min(maxLen, body->length() - index);
+            memcpy(buffer, body->c_str() + index, len);
+            return len;
+        });
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(const String& contentType, size_t len,
+                                                             AwsResponseFiller callback,
+                                                             AwsTemplateProcessor templateCallback)
+{
+    return new AsyncWebServerResponse(200, contentType, len, callback);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String& contentType,
+                                                               const uint8_t* content, size_t len,
+                                                               AwsTemplateProcessor callback)
+{
+    return new AsyncWebServerResponse(code, contentType, len,
+        [content, len](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t chunk = std::min(maxLen, len - index);
+            memcpy(buffer, content + index, chunk);
+            return chunk;
+        });
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String& contentType,
+                                                               PGM_P content, AwsTemplateProcessor callback)
+{
+    return beginResponse_P(code, contentType, reinterpret_cast<const uint8_t*>(content), strlen(content), callback);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String& contentType,
+                                                                    AwsResponseFiller callback,
+                                                                    AwsTemplateProcessor templateCallback)
+{
+    return new AsyncWebServerResponse(200, contentType, 0, callback, true);
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response)
+{
+    delete m_response;
+    m_response = response;
+}
+
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content)
+{
+    send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send_P(int code, const String& contentType, const uint8_t* content, size_t len)
+{
+    send(beginResponse_P(code, contentType, content, len));
+}
+
+void AsyncWebServerRequest::send_P(int code, const String& contentType, PGM_P content)
+{
+    send(beginResponse_P(code, contentType, content));
+}
+
+void AsyncWebServerRequest::redirect(const String& url)
+{
+    AsyncWebServerResponse* response = beginResponse(302);
+    response->addHeader("Location", url);
+    send(response);
+}
+
+void AsyncWebServerRequest::removeNotInterestingHeaders()
+{
+    std::vector<AsyncWebHeader*> kept;
+    for (AsyncWebHeader* header : m_headers) {
+        bool interesting = false;
+        for (const String& name : m_interestingHeaders) {
+            interesting = interesting || name.equalsIgnoreCase(header->name());
+        }
+        if (interesting) {
+            kept.push_back(header);
+        } else {
+            delete header;
+        }
+    }
+    m_headers.swap(kept);
+}
+
+void AsyncWebServerRequest::setHeader(const String& name, const String& value)
+{
+    m_headers.push_back(new AsyncWebHeader(name, value));
+}
+
+void AsyncWebServerRequest::addParam(const String& name, const String& value, bool post)
+{
+    m_params.push_back(new AsyncWebParameter(name, value, post));
+}
+
+void AsyncWebServerRequest::setBody(const String& contentType, const String& body)
+{
+    m_contentType = contentType;
+    m_body = body;
+}
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest* request)
+{
+    return (m_method & request->method()) && request->url() == m_uri;
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest* request)
+{
+    if (m_onRequest) {
+        m_onRequest(request);
+    } else {
+        request->send(500);
+    }
+}
+
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                                         size_t index, size_t total)
+{
+    if (m_onBody) {
+        m_onBody(request, data, len, index, total);
+    }
+}
+
+void AsyncEventSourceClient::send(const char* message, const char* event, uint32_t id, uint32_t reconnect)
+{
+    m_source->record(message, event);
+}
+
+AsyncEventSource::~AsyncEventSource()
+{
+    for (AsyncEventSourceClient* client : m_clients) {
+        delete client;
+    }
+}
+
+void AsyncEventSource::send(const char* message, const char* event, uint32_t id, uint32_t reconnect)
+{
+    for (size_t i = 0; i < m_clients.size(); ++i) {
+        record(message, event);
+    }
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest* request)
+{
+    return request->method() == HTTP_GET && request->url() == m_url;
+}
+
+void AsyncEventSource::handleRequest(AsyncWebServerRequest* request)
+{
+    AsyncEventSourceClient* client = new AsyncEventSourceClient(this);
+    m_clients.push_back(client);
+    if (m_connect) {
+        m_connect(client);
+    }
+}
+
+void AsyncEventSource::record(const char* message, const char* event)
+{
+    ++m_sentCount;
+    if (!m_recording) {
+        return;
+    }
+    Message sent;
+    sent.event = event ? event : "";
+    sent.data = message;
+    m_sent.push_back(sent);
+}
+
+AsyncWebServer::~AsyncWebServer()
+{
+    for (AsyncWebHandler* handler : m_handlers) {
+        delete handler;
+    }
+}
+
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler)
+{
+    m_handlers.push_back(handler);
+    return *handler;
+}
+
+bool AsyncWebServer::removeHandler(AsyncWebHandler* handler)
+{
+    auto it = std::find(m_handlers.begin(), m_handlers.end(), handler);
+    if (it == m_handlers.end()) {
+        return false;
+    }
+    m_handlers.erase(it);
+    return true;
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest)
+{
+    return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest,
+                                            ArUploadHandlerFunction onUpload,
+                                            ArBodyHandlerFunction onBody)
+{
+    AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler(uri, method, onRequest, onBody);
+    addHandler(handler);
+    return *handler;
+}
+
+AsyncWebHandler* AsyncWebServer::handle(AsyncWebServerRequest* request)
+{
+    for (AsyncWebHandler* handler : m_handlers) {
+        if (!handler->canHandle(request)) {
+            continue;
+        }
+        request->removeNotInterestingHeaders();
+        // form bodies are parsed into params by the server, anything else goes to handleBody()
+        const String& body = request->body();
+        if (body.length() > 0 && !request->contentType().startsWith("application/x-www-form-urlencoded")) {
+            std::vector<uint8_t> data(body.c_str(), body.c_str() + body.length());
+            handler->handleBody(request, data.data(), data.size(), 0, data.size());
+        }
+        handler->handleRequest(request);
+        return handler;
+    }
+    request->removeNotInterestingHeaders();
+    if (m_notFound) {
+        m_notFound(request);
+    } else {
+        request->send(404);
+    }
+    return nullptr;
+}
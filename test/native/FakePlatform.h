@@ -0,0 +1,104 @@
+#pragma once
+
+// Control surface of the host platform layer: a manual clock, the radio
+// environment seen by scans and connects, and event injection.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+namespace fake {
+
+struct Network {
+    std::string ssid;
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    wifi_auth_mode_t auth;
+    // beacons without the SSID, only directed scans for it see the name
+    bool hidden = false;
+};
+
+struct WiFiState {
+    wifi_mode_t mode = WIFI_MODE_NULL;
+    wl_status_t status = WL_DISCONNECTED;
+    bool softAp = false;
+    uint8_t apStations = 0;
+
+    std::string savedSsid;
+    std::string savedPassword;
+
+    unsigned beginCalls = 0;
+    std::string beginSsid;
+    std::string beginPassword;
+    int32_t beginChannel = 0;
+    bool beginBssidSet = false;
+    uint8_t beginBssid[6] = { 0 };
+    std::string enterpriseIdentity;
+    std::string enterpriseUsername;
+    std::string enterprisePassword;
+
+    IPAddress staticIP;
+    IPAddress localIP = IPAddress(192, 168, 1, 50);
+    IPAddress gatewayIP = IPAddress(192, 168, 1, 1);
+    IPAddress subnetMask = IPAddress(255, 255, 255, 0);
+    IPAddress dnsIP = IPAddress(192, 168, 1, 1);
+    // DHCP lease offered with localIP
+    uint32_t leaseSeconds = 3600;
+    uint8_t connectedChannel = 6;
+    uint8_t connectedBssid[6] = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 };
+    int8_t rssi = -60;
+    uint8_t mac[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+
+    std::vector<Network> networks;
+    // time a started scan stays in WIFI_SCAN_RUNNING
+    uint32_t scanDuration = 0;
+    unsigned scansStarted = 0;
+    unsigned directedScans = 0;
+    std::string lastScanSsid;
+    unsigned restarts = 0;
+    // WiFi.disconnect() of a connected station reports STA_DISCONNECTED with
+    // ASSOC_LEAVE like the SDK, this many ms later when not 0
+    uint32_t leaveEventDelay = 0;
+};
+
+struct UdpPacket {
+    IPAddress remoteIP;
+    uint16_t remotePort;
+    uint16_t length;
+    uint8_t data[1500];
+};
+
+// fixed rings, so the fake does not allocate in the benchmarks
+struct UdpState {
+    static const size_t Capacity = 64;
+    uint16_t boundPort = 0;
+    UdpPacket inbound[Capacity];
+    size_t inboundHead = 0;
+    size_t inboundCount = 0;
+    unsigned sent = 0;
+    UdpPacket lastSent;
+};
+
+void reset();
+WiFiState& wifi();
+UdpState& udp();
+
+// queues a datagram for the socket bound to port, false if none is or the ring is full
+bool sendUdp(uint16_t port, const uint8_t* data, size_t length,
+             IPAddress from = IPAddress(192, 168, 4, 2), uint16_t fromPort = 5353);
+
+void setMillis(uint32_t now);
+// moves the clock forward and fires due Tickers
+void advanceMillis(uint32_t ms);
+
+// delivers an event through the callbacks registered with WiFi.onEvent(),
+// reason goes into the event info of STA_DISCONNECTED
+void emitEvent(system_event_id_t event, uint8_t reason = WIFI_REASON_UNSPECIFIED);
+// STA_CONNECTED + STA_GOT_IP with the state of the last begin()
+void connectStation();
+void disconnectStation(uint8_t reason = WIFI_REASON_UNSPECIFIED);
+
+void setSerialEcho(bool echo);
+size_t serialBytes();
+
+} // namespace fake
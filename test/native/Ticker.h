@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Fires from fake::advanceMillis() instead of a hardware timer.
+class Ticker
+{
+public:
+    typedef void (*callback_t)(void);
+
+    ~Ticker() { detach(); }
+
+    void once(float seconds, callback_t callback);
+    void once_ms(uint32_t milliseconds, callback_t callback);
+    void detach();
+    bool active() const { return m_callback != nullptr; }
+
+    void fireIfDue(uint32_t now);
+
+private:
+    callback_t m_callback = nullptr;
+    uint32_t m_deadline = 0;
+};
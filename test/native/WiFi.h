@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+#define WIFI_SCANNING_BIT (1 << 11)
+#define WIFI_SCAN_DONE_BIT (1 << 12)
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum {
+    SYSTEM_EVENT_WIFI_READY = 0,
+    SYSTEM_EVENT_SCAN_DONE,
+    SYSTEM_EVENT_STA_START,
+    SYSTEM_EVENT_STA_STOP,
+    SYSTEM_EVENT_STA_CONNECTED,
+    SYSTEM_EVENT_STA_DISCONNECTED,
+    SYSTEM_EVENT_STA_AUTHMODE_CHANGE,
+    SYSTEM_EVENT_STA_GOT_IP,
+    SYSTEM_EVENT_STA_LOST_IP,
+    SYSTEM_EVENT_STA_WPS_ER_SUCCESS,
+    SYSTEM_EVENT_STA_WPS_ER_FAILED,
+    SYSTEM_EVENT_STA_WPS_ER_TIMEOUT,
+    SYSTEM_EVENT_STA_WPS_ER_PIN,
+    SYSTEM_EVENT_STA_WPS_ER_PBC_OVERLAP,
+    SYSTEM_EVENT_AP_START,
+    SYSTEM_EVENT_AP_STOP,
+    SYSTEM_EVENT_AP_STACONNECTED,
+    SYSTEM_EVENT_AP_STADISCONNECTED,
+    SYSTEM_EVENT_AP_STAIPASSIGNED,
+    SYSTEM_EVENT_AP_PROBEREQRECVED,
+    SYSTEM_EVENT_GOT_IP6,
+    SYSTEM_EVENT_ETH_START,
+    SYSTEM_EVENT_ETH_STOP,
+    SYSTEM_EVENT_ETH_CONNECTED,
+    SYSTEM_EVENT_ETH_DISCONNECTED,
+    SYSTEM_EVENT_ETH_GOT_IP,
+    SYSTEM_EVENT_MAX
+} system_event_id_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+} system_event_sta_disconnected_t;
+
+typedef union {
+    system_event_sta_disconnected_t disconnected;
+} system_event_info_t;
+
+typedef struct {
+    system_event_id_t event_id;
+    system_event_info_t event_info;
+} system_event_t;
+
+typedef system_event_id_t WiFiEvent_t;
+typedef void (*WiFiEventCb)(system_event_id_t event);
+typedef void (*WiFiEventSysCb)(system_event_t* event);
+
+class WiFiGenericClass
+{
+public:
+    static int getStatusBits();
+    static int setStatusBits(int bits);
+    static int clearStatusBits(int bits);
+};
+
+class WiFiScanClass
+{
+public:
+    int16_t scanNetworks(bool async = false, bool show_hidden = false, bool passive = false,
+                         uint32_t max_ms_per_chan = 300);
+    int16_t scanComplete();
+    void scanDelete();
+    uint8_t encryptionType(uint8_t networkItem);
+    String SSID(uint8_t networkItem);
+
+protected:
+    static void* _getScanInfoByIndex(int i);
+};
+
+class WiFiClass : public WiFiGenericClass, public WiFiScanClass
+{
+public:
+    using WiFiScanClass::SSID;
+
+    int onEvent(WiFiEventCb callback, system_event_id_t event = SYSTEM_EVENT_MAX);
+    int onEvent(WiFiEventSysCb callback, system_event_id_t event = SYSTEM_EVENT_MAX);
+
+    bool mode(wifi_mode_t mode);
+    wifi_mode_t getMode();
+    wl_status_t status();
+
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    bool disconnect(bool wifioff = false, bool eraseap = false);
+    bool setHostname(const char* hostname);
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t dns_no = 0);
+    String SSID() const;
+    uint8_t* BSSID();
+    String BSSIDstr();
+    int32_t channel();
+    int8_t RSSI();
+    uint8_t* macAddress(uint8_t* mac);
+
+    bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet);
+    bool softAP(const char* ssid, const char* passphrase = nullptr, int channel = 1,
+                int ssid_hidden = 0, int max_connection = 4);
+    bool softAPdisconnect(bool wifioff = false);
+    uint8_t softAPgetStationNum();
+    IPAddress softAPIP();
+
+    void printDiag(Print& dest);
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+
+// One bound socket, fed by fake::sendUdp(); replies land in fake::udp().
+class WiFiUDP
+{
+public:
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int parsePacket();
+    int available() const { return m_rxLength - m_rxPosition; }
+    int read(uint8_t* buffer, size_t len);
+    IPAddress remoteIP() const { return m_remoteIP; }
+    uint16_t remotePort() const { return m_remotePort; }
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t* buffer, size_t size);
+    int endPacket();
+
+private:
+    bool m_bound = false;
+    IPAddress m_remoteIP;
+    uint16_t m_remotePort = 0;
+    uint8_t m_rx[1500];
+    int m_rxLength = 0;
+    int m_rxPosition = 0;
+    IPAddress m_txIP;
+    uint16_t m_txPort = 0;
+    uint8_t m_tx[1500];
+    size_t m_txLength = 0;
+};
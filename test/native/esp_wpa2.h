@@ -0,0 +1,14 @@
+#pragma once
+
+#include <esp_wifi.h>
+
+typedef struct {
+    int placeholder;
+} esp_wpa2_config_t;
+
+#define WPA2_CONFIG_INIT_DEFAULT() { 0 }
+
+esp_err_t esp_wifi_sta_wpa2_ent_enable(const esp_wpa2_config_t* config);
+esp_err_t esp_wifi_sta_wpa2_ent_set_identity(const unsigned char* identity, int len);
+esp_err_t esp_wifi_sta_wpa2_ent_set_username(const unsigned char* username, int len);
+esp_err_t esp_wifi_sta_wpa2_ent_set_password(const unsigned char* password, int len);
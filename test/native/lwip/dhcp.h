@@ -0,0 +1,10 @@
+#pragma once
+
+#include <lwip/netif.h>
+#include <stdint.h>
+
+struct dhcp {
+    uint32_t offered_t0_lease;
+};
+
+struct dhcp* netif_dhcp_data(struct netif* netif);
@@ -0,0 +1,5 @@
+#pragma once
+
+// the station interface once it is up, see fake::WiFiState::leaseSeconds
+struct netif;
+extern struct netif* netif_default;
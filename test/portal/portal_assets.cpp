@@ -0,0 +1,109 @@
+// Portal assets on the host fake: each request gets its own asset when
+// others are matched between canHandle() and handleRequest(), HEAD gets the
+// headers without the body, and a matching If-None-Match gets 304.
+//
+//   espreact_portal_assets
+
+#include <ESPReactWifiManager.h>
+#include <ESPAsyncWebServer.h>
+#include <FakePlatform.h>
+
+#include <stdio.h>
+
+namespace {
+
+// what tools/generate_assets.py emits, sorted by path
+const char appPath[] PROGMEM = "/assets/app.js";
+const char appType[] PROGMEM = "application/javascript";
+const char appEtag[] PROGMEM = "\"aaaaaaaaaaaaaaaa\"";
+const uint8_t appData[300] PROGMEM = { 0x1f, 0x8b };
+const char indexPath[] PROGMEM = "/wifi.html";
+const char indexType[] PROGMEM = "text/html";
+const char indexEtag[] PROGMEM = "\"0123456789abcdef\"";
+const uint8_t indexData[100] PROGMEM = { 0x1f, 0x8b };
+const PortalAsset assets[] PROGMEM = {
+    { appPath, appType, appEtag, appData, sizeof(appData), true, true },
+    { indexPath, indexType, indexEtag, indexData, sizeof(indexData), true, false },
+};
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+String header(AsyncWebServerRequest& request, const char* name)
+{
+    const AsyncWebHeader* found = request.response() ? request.response()->header(name) : nullptr;
+    return found ? found->value() : String();
+}
+
+void interleaved(AsyncWebServer& server)
+{
+    const char* name = "interleaved";
+    AsyncWebServerRequest first(HTTP_GET, "/");
+    AsyncWebHandler* handler = server.handle(&first);
+    expect(handler, name, "no handler for the default asset");
+    if (!handler) {
+        return;
+    }
+
+    // the async_tcp task matches the second request before the first is handled
+    AsyncWebServerRequest script(HTTP_GET, "/assets/app.js");
+    AsyncWebServerRequest index(HTTP_GET, "/");
+    expect(handler->canHandle(&script) && handler->canHandle(&index), name, "assets not matched");
+    handler->handleRequest(&script);
+    handler->handleRequest(&index);
+
+    expect(script.response() && script.response()->contentType() == "application/javascript"
+           && script.response()->drain().length() == sizeof(appData), name, "script got another asset");
+    expect(index.response() && index.response()->contentType() == "text/html"
+           && index.response()->drain().length() == sizeof(indexData), name, "index got another asset");
+}
+
+void head(AsyncWebServer& server)
+{
+    const char* name = "head";
+    AsyncWebServerRequest request(HTTP_HEAD, "/assets/app.js");
+    server.handle(&request);
+    expect(request.response() && request.response()->code() == 200, name, "HEAD not answered");
+    if (!request.response()) {
+        return;
+    }
+    expect(request.response()->drain().length() == 0, name, "HEAD got the body");
+    expect(request.response()->contentType() == "application/javascript", name, "wrong Content-Type");
+    expect(header(request, "ETag") == "\"aaaaaaaaaaaaaaaa\"", name, "no ETag");
+    expect(header(request, "Content-Encoding") == "gzip", name, "no Content-Encoding");
+}
+
+void notModified(AsyncWebServer& server)
+{
+    const char* name = "not modified";
+    AsyncWebServerRequest request(HTTP_GET, "/wifi.html");
+    request.setHeader("If-None-Match", "\"0123456789abcdef\"");
+    server.handle(&request);
+    expect(request.response() && request.response()->code() == 304, name, "matching ETag not 304");
+}
+
+} // namespace
+
+int main()
+{
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    manager.setupHandlers(&server);
+    manager.setPortalAssets(assets, sizeof(assets) / sizeof(assets[0]));
+
+    interleaved(server);
+    head(server);
+    notModified(server);
+    if (failures == 0) {
+        printf("portal assets passed\n");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+// /wifiList on the host fake: the ETag follows the scan generation and
+// answers If-None-Match with 304, a response keeps sending its own
+// snapshot while later scans publish, /wifiEvents pushes the entries a
+// scan added, changed and removed, and ?refresh=1 rescans only stale
+// results, reported in X-Scan-Age and X-Scan-Pending.
+//
+//   espreact_wifi_list
+
+#include <ESPReactWifiManager.h>
+#include <ESPAsyncWebServer.h>
+#include <FakePlatform.h>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+void addNetwork(const char* ssid, uint8_t id, int8_t rssi)
+{
+    fake::Network network;
+    network.ssid = ssid;
+    memset(network.bssid, id, sizeof(network.bssid));
+    network.rssi = rssi;
+    network.channel = id;
+    network.auth = WIFI_AUTH_WPA2_PSK;
+    fake::wifi().networks.push_back(network);
+}
+
+String header(AsyncWebServerRequest& request, const char* name)
+{
+    const AsyncWebHeader* found = request.response() ? request.response()->header(name) : nullptr;
+    return found ? found->value() : String();
+}
+
+// settings live in module state and outlast a manager, every scenario sets them
+void setUp(ESPReactWifiManager& manager, AsyncWebServer& server)
+{
+    manager.setupHandlers(&server);
+    manager.setAsyncScan(false);
+    manager.setScanCacheTtl(30000);
+    addNetwork("home", 1, -50);
+    addNetwork("office", 6, -70);
+}
+
+void notModified()
+{
+    const char* name = "not modified";
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    setUp(manager, server);
+    manager.scan();
+
+    AsyncWebServerRequest first(HTTP_GET, "/wifiList");
+    server.handle(&first);
+    String etag = header(first, "ETag");
+    String body = first.response()->drain();
+    expect(first.response()->code() == 200, name, "first request not 200");
+    expect(etag.length() > 2 && etag[0] == '"', name, "no quoted ETag");
+    expect(body.indexOf("\"home\"") > 0 && body.indexOf("\"office\"") > 0, name, "networks missing");
+    expect(first.response()->contentLength() == body.length(), name, "Content-Length does not match the body");
+
+    AsyncWebServerRequest cached(HTTP_GET, "/wifiList");
+    cached.setHeader("If-None-Match", etag);
+    server.handle(&cached);
+    expect(cached.response()->code() == 304, name, "matching ETag not 304");
+    expect(header(cached, "ETag") == etag, name, "304 without the generation ETag");
+    expect(cached.response()->drain().length() == 0, name, "304 with a body");
+
+    manager.scan();
+    AsyncWebServerRequest rescanned(HTTP_GET, "/wifiList");
+    rescanned.setHeader("If-None-Match", etag);
+    server.handle(&rescanned);
+    expect(rescanned.response()->code() == 200, name, "old ETag still matches after a scan");
+    expect(header(rescanned, "ETag") != etag, name, "ETag unchanged after a scan");
+}
+
+// two scans publish while the first response is half sent, the second one
+// into the spare body that response would hold without its own reference
+void snapshotSurvivesPublish()
+{
+    const char* name = "snapshot";
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    setUp(manager, server);
+    manager.scan();
+
+    AsyncWebServerRequest expected(HTTP_GET, "/wifiList");
+    server.handle(&expected);
+    String snapshot = expected.response()->drain();
+
+    AsyncWebServerRequest request(HTTP_GET, "/wifiList");
+    server.handle(&request);
+    AsyncWebServerResponse* response = request.response();
+    const size_t chunk = 16;
+    String body = response->fill(0, chunk);
+
+    fake::wifi().networks.clear();
+    addNetwork("cafe", 11, -40);
+    manager.scan();
+    addNetwork("library-with-a-much-longer-name", 3, -60);
+    manager.scan();
+
+    while (body.length() < response->contentLength()) {
+        String next = response->fill(body.length(), chunk);
+        if (next.length() == 0) {
+            break;
+        }
+        body += next;
+    }
+    expect(body == snapshot, name, "response changed by a scan published mid-send");
+
+    AsyncWebServerRequest latest(HTTP_GET, "/wifiList");
+    server.handle(&latest);
+    String current = latest.response()->drain();
+    expect(current.indexOf("\"library-with-a-much-longer-name\"") > 0 && current.indexOf("\"home\"") < 0,
+           name, "new request did not get the latest scan");
+}
+
+void scanDelta()
+{
+    const char* name = "scan delta";
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    setUp(manager, server);
+    addNetwork("lab", 9, -60);
+    manager.scan();
+
+    AsyncWebServerRequest subscribe(HTTP_GET, "/wifiEvents");
+    AsyncEventSource* events = static_cast<AsyncEventSource*>(server.handle(&subscribe));
+    expect(events && events->count() == 1, name, "no event client");
+    if (!events) {
+        return;
+    }
+    events->clearSent();
+
+    // home within the jitter, office weaker, cafe new, lab gone
+    fake::wifi().networks.clear();
+    addNetwork("home", 1, -52);
+    addNetwork("office", 6, -85);
+    addNetwork("cafe", 11, -40);
+    manager.scan();
+
+    const AsyncEventSource::Message* delta = nullptr;
+    for (const AsyncEventSource::Message& message : events->sent()) {
+        if (message.event == "scan") {
+            expect(!delta, name, "more than one delta per scan");
+            delta = &message;
+        }
+    }
+    expect(delta, name, "no scan event");
+    if (!delta) {
+        return;
+    }
+    int changedAt = delta->data.indexOf("\"changed\":[");
+    int removedAt = delta->data.indexOf("],\"removed\":[");
+    expect(changedAt > 0 && removedAt > changedAt, name, "no changed and removed lists");
+    String changed = delta->data.substring(changedAt, removedAt);
+    String removed = delta->data.substring(removedAt);
+    expect(changed.indexOf("\"cafe\"") > 0, name, "added entry missing");
+    expect(changed.indexOf("\"office\"") > 0 && changed.indexOf("\"signalStrength\":30") > 0,
+           name, "changed entry missing");
+    expect(changed.indexOf("\"home\"") < 0, name, "signal jitter pushed");
+    expect(removed == "],\"removed\":[\"lab\"]}", name, "removed entry missing");
+    expect(delta->data.startsWith("{\"generation\":"), name, "no generation");
+}
+
+String refresh(AsyncWebServer& server, const char* name)
+{
+    AsyncWebServerRequest request(HTTP_GET, "/wifiList");
+    request.addParam("refresh", "1");
+    server.handle(&request);
+    return header(request, name);
+}
+
+void scanAge()
+{
+    const char* name = "scan age";
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    setUp(manager, server);
+
+    manager.scan();
+    unsigned scans = fake::wifi().scansStarted;
+
+    // fresh: the cached results are answered without a scan
+    fake::advanceMillis(5000);
+    expect(refresh(server, "X-Scan-Age") == "5", name, "wrong age of fresh results");
+    expect(refresh(server, "X-Scan-Pending").length() == 0, name, "fresh results rescanned");
+    manager.loop();
+    expect(fake::wifi().scansStarted == scans, name, "scan started for fresh results");
+
+    // stale: the old results are answered and a scan is started
+    fake::advanceMillis(26000);
+    expect(refresh(server, "X-Scan-Age") == "31", name, "wrong age of stale results");
+    expect(refresh(server, "X-Scan-Pending") == "1", name, "stale results not rescanned");
+    manager.loop();
+    expect(fake::wifi().scansStarted == scans + 1, name, "refresh of stale results did not scan");
+    expect(refresh(server, "X-Scan-Age") == "0", name, "age not reset by the scan");
+}
+
+} // namespace
+
+int main()
+{
+    notModified();
+    snapshotSurvivesPublish();
+    scanDelta();
+    scanAge();
+
+    if (failures == 0) {
+        printf("wifiList passed\n");
+    }
+    return failures ? 1 : 0;
+}
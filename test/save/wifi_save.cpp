@@ -0,0 +1,231 @@
+// /wifiSave on the host fake. WifiSaveParser gives the same form whether a
+// body arrives whole or split at any byte, decodes escapes, refuses
+// oversized fields, nested values on known keys and truncated bodies, skips
+// unknown keys, and takes form parameters through assign(). The handler keeps
+// its state per request: a client that drops mid-body or a form POST
+// arriving during a JSON upload does not disturb another save.
+//
+//   espreact_wifi_save
+
+#include <ESPReactWifiManager.h>
+#include <ESPReactWifiManagerSave.h>
+#include <ESPAsyncWebServer.h>
+#include <FakePlatform.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+// parses body in two feeds split at split, returns the error or nullptr
+const char* parse(const std::string& body, WifiSaveForm& form, size_t split = 0)
+{
+    WifiSaveParser parser;
+    parser.begin(&form, true);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(body.data());
+    parser.feed(data, split);
+    parser.feed(data + split, body.size() - split);
+    return parser.finish();
+}
+
+bool isError(const char* error, const char* expected)
+{
+    return error && strcmp_P(expected, error) == 0;
+}
+
+void splitAtEveryByte()
+{
+    const char* name = "split";
+    const std::string body = "{\"ssid\":\"caf\\u00e9 \\\"bar\\\"\", \"password\":\"p\\\\w\\/x\","
+                             "\"extra\":{\"a\":[1,{\"b\":\"}]\\\"\"}],\"c\":null},"
+                             "\"channel\":6,\"bssid\":\"aa:bb:cc:dd:ee:ff\",\"list\":[[],{}]}";
+    WifiSaveForm whole;
+    expect(parse(body, whole) == nullptr, name, "whole body refused");
+    expect(strcmp(whole.ssid, "caf\xc3\xa9 \"bar\"") == 0, name, "ssid escapes not decoded");
+    expect(strcmp(whole.password, "p\\w/x") == 0, name, "password escapes not decoded");
+    expect(strcmp(whole.channel, "6") == 0, name, "numeric channel lost");
+    expect(strcmp(whole.bssid, "aa:bb:cc:dd:ee:ff") == 0, name, "field after a skipped value lost");
+
+    for (size_t split = 1; split < body.size(); ++split) {
+        WifiSaveForm form;
+        const char* error = parse(body, form, split);
+        if (error || memcmp(&form, &whole, sizeof(form)) != 0) {
+            fprintf(stderr, "%s: different form when split at %u\n", name, static_cast<unsigned>(split));
+            ++failures;
+            return;
+        }
+    }
+}
+
+void fieldSizes()
+{
+    const char* name = "field sizes";
+    WifiSaveForm form;
+    const std::string ssid32(32, 's');
+    const std::string password64(64, 'p');
+    expect(parse("{\"ssid\":\"" + ssid32 + "\",\"password\":\"" + password64 + "\"}", form) == nullptr,
+           name, "fields at the SDK limit refused");
+    expect(isError(parse("{\"ssid\":\"" + ssid32 + "s\"}", form), PSTR("field too long")),
+           name, "33 byte ssid taken");
+    expect(isError(parse("{\"password\":\"" + password64 + "p\"}", form), PSTR("field too long")),
+           name, "65 byte password taken");
+    // two bytes of UTF-8 for one escape
+    expect(isError(parse("{\"ssid\":\"" + std::string(31, 's') + "\\u00e9\"}", form), PSTR("field too long")),
+           name, "escape past the ssid limit taken");
+    // unknown keys of any length are skipped
+    expect(parse("{\"" + std::string(100, 'k') + "\":\"" + std::string(300, 'v') + "\",\"ssid\":\"x\"}", form)
+           == nullptr && strcmp(form.ssid, "x") == 0, name, "long unknown key not skipped");
+}
+
+void values()
+{
+    const char* name = "values";
+    WifiSaveForm form;
+    expect(parse("{\"ssid\":\"home\",\"channel\":null}", form) == nullptr && form.channel[0] == 0,
+           name, "null channel not empty");
+    expect(parse("{\"ssid\":\"home\",\"channel\":11}", form) == nullptr && strcmp(form.channel, "11") == 0,
+           name, "numeric channel lost");
+    expect(parse("{\"ssid\":\"home\",\"channel\":\"11\"}", form) == nullptr && strcmp(form.channel, "11") == 0,
+           name, "string channel lost");
+    expect(parse("{\"ssid\":\"home\",\"channel\":1234}", form) != nullptr, name, "channel past its field taken");
+    expect(isError(parse("{\"ssid\":{\"a\":1}}", form), PSTR("nested values are not supported")),
+           name, "nested value on a known key taken");
+    expect(isError(parse("{\"ssid\":[\"a\"]}", form), PSTR("nested values are not supported")),
+           name, "array on a known key taken");
+    expect(isError(parse("{\"ssid\":\"a\\u0000\"}", form), PSTR("unsupported escape")), name, "NUL escape taken");
+    expect(isError(parse("{\"ssid\":\"a\\x\"}", form), PSTR("malformed JSON")), name, "bad escape taken");
+    expect(isError(parse("[\"ssid\"]", form), PSTR("malformed JSON")), name, "array body taken");
+    expect(isError(parse("{\"ssid\":\"a\"} x", form), PSTR("malformed JSON")), name, "trailing data taken");
+}
+
+void truncated()
+{
+    const char* name = "truncated";
+    const std::string body = "{\"ssid\":\"home\",\"channel\":6,\"extra\":{\"a\":[1]}}";
+    for (size_t length = 0; length < body.size(); ++length) {
+        WifiSaveForm form;
+        if (!isError(parse(body.substr(0, length), form), PSTR("malformed JSON"))) {
+            fprintf(stderr, "%s: body cut at %u taken\n", name, static_cast<unsigned>(length));
+            ++failures;
+            return;
+        }
+    }
+}
+
+void formParams()
+{
+    const char* name = "form";
+    WifiSaveForm form;
+    WifiSaveParser parser;
+    parser.begin(&form, false);
+    parser.assign("ssid", "caf\xc3\xa9", 5);
+    parser.assign("unknown", "ignored", 7);
+    parser.assign("channel", "6", 1);
+    expect(parser.finish() == nullptr, name, "form refused");
+    expect(strcmp(form.ssid, "caf\xc3\xa9") == 0 && strcmp(form.channel, "6") == 0, name, "form fields lost");
+
+    const std::string password(65, 'p');
+    parser.begin(&form, false);
+    parser.assign("ssid", "home", 4);
+    parser.assign("password", password.c_str(), password.size());
+    expect(isError(parser.finish(), PSTR("field too long")), name, "65 byte password taken");
+}
+
+// the body of request delivered in two chunks, like the server does for a
+// body split over TCP segments; handleRequest() follows when finish is set
+void deliver(AsyncWebHandler* handler, AsyncWebServerRequest& request, size_t from, size_t to)
+{
+    const String& body = request.body();
+    std::string data(body.c_str() + from, body.c_str() + to);
+    handler->handleBody(&request, reinterpret_cast<uint8_t*>(&data[0]), data.size(), from, body.length());
+}
+
+int status(AsyncWebServerRequest& request)
+{
+    return request.response() ? request.response()->code() : 0;
+}
+
+void perRequestState()
+{
+    const char* name = "per request";
+    fake::reset();
+    ESPReactWifiManager manager;
+    AsyncWebServer server(80);
+    manager.setupHandlers(&server);
+    manager.setFallbackToAp(false);
+    manager.clearNetworks();
+
+    AsyncWebServerRequest probe(HTTP_POST, "/wifiSave");
+    AsyncWebHandler* handler = server.handle(&probe);
+    expect(handler && status(probe) == 400, name, "save without ssid not refused");
+    if (!handler) {
+        return;
+    }
+
+    // a JSON POST without a body
+    {
+        AsyncWebServerRequest empty(HTTP_POST, "/wifiSave");
+        empty.setBody("application/json", "");
+        server.handle(&empty);
+        expect(status(empty) == 400, name, "JSON POST without a body not refused as malformed");
+    }
+
+    // the client drops mid-body, the request is freed without handleRequest()
+    {
+        AsyncWebServerRequest dropped(HTTP_POST, "/wifiSave");
+        dropped.setBody("application/json", "{\"ssid\":\"dropped\",\"password\":\"secret\"}");
+        deliver(handler, dropped, 0, 10);
+    }
+    {
+        AsyncWebServerRequest empty(HTTP_POST, "/wifiSave");
+        empty.setBody("application/json", "");
+        server.handle(&empty);
+        expect(status(empty) == 400, name, "request after a dropped one not refused as malformed");
+    }
+
+    // a form POST arrives while a JSON upload is between segments
+    AsyncWebServerRequest upload(HTTP_POST, "/wifiSave");
+    upload.setBody("application/json", "{\"ssid\":\"upload\",\"password\":\"secret\"}");
+    deliver(handler, upload, 0, 12);
+    {
+        AsyncWebServerRequest form(HTTP_POST, "/wifiSave");
+        form.setBody("application/x-www-form-urlencoded", "");
+        form.addParam("ssid", "form", true);
+        server.handle(&form);
+        expect(status(form) == 200, name, "form POST refused");
+    }
+    manager.loop();
+    deliver(handler, upload, 12, upload.body().length());
+    handler->handleRequest(&upload);
+    expect(status(upload) == 200 && upload.response()->drain() == "Connecting to: upload",
+           name, "JSON upload disturbed by a form POST");
+    manager.loop();
+    expect(manager.networkCount() == 2, name, "saves not stored");
+}
+
+} // namespace
+
+int main()
+{
+    splitAtEveryByte();
+    fieldSizes();
+    values();
+    truncated();
+    formParams();
+    perRequestState();
+    if (failures == 0) {
+        printf("wifiSave passed\n");
+    }
+    return failures ? 1 : 0;
+}
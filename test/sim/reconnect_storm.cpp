@@ -0,0 +1,193 @@
+// Reconnect storm simulation: a fleet of devices loses its access point at
+// the same moment and retries with the library's reconnect schedule. The AP
+// is down for a while after rebooting and then admits a limited number of
+// associations per second; attempts above that fail and go back to backoff.
+//
+//   espreact_reconnect_storm [devices] [--curve]
+//
+// Prints, per policy, the peak attempt rate the AP sees and how long the
+// fleet takes to get back. --curve adds attempts and connected devices per
+// second. Exits 1 if a jittered policy does not beat the legacy fixed delay.
+
+#include <ESPReactWifiManagerBackoff.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+const uint32_t stepMs = 100;
+const uint32_t horizonMs = 15 * 60 * 1000;
+const uint32_t apDownMs = 20 * 1000;
+const uint32_t admitPerSecond = 10;
+// association, handshake and DHCP before the attempt is known to fail
+const uint32_t attemptMs = 3000;
+const uint8_t retryLimit = 5;
+// setApRetryInterval() default, added to the backoff delay after falling back
+const uint32_t apRetryMs = 60 * 1000;
+
+struct Device {
+    Backoff backoff;
+    uint8_t retryCount;
+    uint32_t nextAttempt;
+    uint32_t attemptEnds;
+    bool admitted;
+    bool connected;
+
+    explicit Device(const BackoffPolicy& policy)
+        : backoff(policy), retryCount(0), nextAttempt(0), attemptEnds(0), admitted(false), connected(false)
+    {
+    }
+};
+
+struct Scenario {
+    const char* name;
+    BackoffPolicy policy;
+    // before 011 the retries after falling back to AP used a fixed 60 s
+    bool legacyApInterval;
+};
+
+struct Result {
+    uint32_t peakAttempts;
+    uint32_t totalAttempts;
+    uint32_t halfConnectedMs;
+    uint32_t allConnectedMs;
+};
+
+// mirrors checkRetryCount(): retries on the backoff delay, the ones after
+// retryLimit happen from AP mode and wait the AP retry interval on top
+uint32_t retryDelay(Device& device, const Scenario& scenario)
+{
+    uint32_t delay = device.backoff.next();
+    if (++device.retryCount > retryLimit) {
+        return scenario.legacyApInterval ? 60 * 1000 : apRetryMs + delay;
+    }
+    return delay;
+}
+
+Result simulate(const Scenario& scenario, size_t count, bool curve)
+{
+    std::vector<Device> devices;
+    devices.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        devices.emplace_back(scenario.policy);
+        uint8_t mac[6] = { 0x24, 0x0a, 0xc4, 0x00, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i) };
+        devices.back().backoff.seed(mac, sizeof(mac));
+    }
+
+    // every device sees the disconnect at t = 0
+    for (Device& device : devices) {
+        device.nextAttempt = retryDelay(device, scenario);
+    }
+
+    Result result = { 0, 0, 0, 0 };
+    uint32_t secondAttempts = 0;
+    uint32_t secondAdmitted = 0;
+    size_t connected = 0;
+
+    if (curve) {
+        printf("  %6s %9s %10s\n", "second", "attempts", "connected");
+    }
+
+    for (uint32_t now = 0; now < horizonMs && connected < count; now += stepMs) {
+        for (Device& device : devices) {
+            if (device.connected) {
+                continue;
+            }
+            if (device.attemptEnds && now >= device.attemptEnds) {
+                device.attemptEnds = 0;
+                if (device.admitted) {
+                    device.connected = true;
+                    ++connected;
+                    if (!result.halfConnectedMs && connected * 2 >= count) {
+                        result.halfConnectedMs = now;
+                    }
+                    if (connected == count) {
+                        result.allConnectedMs = now;
+                    }
+                    continue;
+                }
+                device.nextAttempt = now + retryDelay(device, scenario);
+            }
+            if (!device.attemptEnds && now >= device.nextAttempt) {
+                ++secondAttempts;
+                ++result.totalAttempts;
+                device.admitted = now >= apDownMs && secondAdmitted < admitPerSecond;
+                if (device.admitted) {
+                    ++secondAdmitted;
+                }
+                device.attemptEnds = now + attemptMs;
+            }
+        }
+
+        if ((now + stepMs) % 1000 == 0) {
+            if (secondAttempts > result.peakAttempts) {
+                result.peakAttempts = secondAttempts;
+            }
+            if (curve && (secondAttempts || connected < count)) {
+                printf("  %6u %9u %10zu\n", static_cast<unsigned>(now / 1000),
+                       static_cast<unsigned>(secondAttempts), connected);
+            }
+            secondAttempts = 0;
+            secondAdmitted = 0;
+        }
+    }
+
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t count = 300;
+    bool curve = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--curve") == 0) {
+            curve = true;
+        } else {
+            count = strtoul(argv[i], nullptr, 10);
+        }
+    }
+
+    const Scenario scenarios[] = {
+        { "legacy fixed 5s/60s", { 5000, 5000, 1.0f, BackoffJitter::None }, true },
+        { "exponential", { 5000, 60 * 1000, 2.0f, BackoffJitter::None }, false },
+        { "full jitter", { 5000, 60 * 1000, 2.0f, BackoffJitter::Full }, false },
+        { "decorrelated jitter", { 5000, 60 * 1000, 2.0f, BackoffJitter::Decorrelated }, false },
+    };
+
+    printf("%zu devices, AP down %us, admits %u/s\n", count,
+           static_cast<unsigned>(apDownMs / 1000), static_cast<unsigned>(admitPerSecond));
+    printf("%-22s %10s %10s %10s %10s\n", "policy", "peak/s", "attempts", "50% at s", "100% at s");
+
+    Result results[sizeof(scenarios) / sizeof(scenarios[0])];
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        if (curve) {
+            printf("%s\n", scenarios[i].name);
+        }
+        results[i] = simulate(scenarios[i], count, curve);
+        char half[16] = "never";
+        char all[16] = "never";
+        if (results[i].halfConnectedMs) {
+            snprintf(half, sizeof(half), "%.1f", results[i].halfConnectedMs / 1000.0);
+        }
+        if (results[i].allConnectedMs) {
+            snprintf(all, sizeof(all), "%.1f", results[i].allConnectedMs / 1000.0);
+        }
+        printf("%-22s %10u %10u %10s %10s\n", scenarios[i].name,
+               static_cast<unsigned>(results[i].peakAttempts),
+               static_cast<unsigned>(results[i].totalAttempts), half, all);
+    }
+
+    int status = 0;
+    for (size_t i = 2; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        if (!results[i].allConnectedMs || results[i].peakAttempts >= results[0].peakAttempts) {
+            fprintf(stderr, "%s does not spread the reconnect storm\n", scenarios[i].name);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,334 @@
+// Known network store on the host fake: records survive a reboot with every
+// field, a damaged file or an unknown store version is ignored while newer
+// record versions are read, a full table replaces the network used longest
+// ago, connect() ranks by RSSI and connect history, and reconnects to the
+// same network leave the file alone within the write interval.
+//
+//   espreact_network_store
+
+#include <ESPReactWifiManager.h>
+#include <FakePlatform.h>
+#include <SPIFFS.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace {
+
+typedef ESPReactWifiManager::ConnectState ConnectState;
+
+const char storeFile[] = "/wifi.nets";
+// header: magic, store version, count; then per record: version, length
+const size_t storeVersionOffset = 4;
+const size_t firstRecordOffset = 6;
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+void addNetwork(const char* ssid, uint8_t id, int8_t rssi)
+{
+    fake::Network network;
+    network.ssid = ssid;
+    memset(network.bssid, id, sizeof(network.bssid));
+    network.rssi = rssi;
+    network.channel = id;
+    network.auth = WIFI_AUTH_WPA2_PSK;
+    fake::wifi().networks.push_back(network);
+}
+
+std::string readStore()
+{
+    std::string data;
+    File file = SPIFFS.open(storeFile, "r");
+    uint8_t buffer[64];
+    size_t length;
+    while (file && (length = file.read(buffer, sizeof(buffer))) > 0) {
+        data.append(reinterpret_cast<const char*>(buffer), length);
+    }
+    return data;
+}
+
+void writeStore(const std::string& data)
+{
+    File file = SPIFFS.open(storeFile, "w");
+    file.write(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    file.close();
+}
+
+// the FNV-1a trailer over everything before it
+void resealStore(std::string& data)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i + 4 < data.size(); ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    data.replace(data.size() - 4, 4, reinterpret_cast<const char*>(&hash), 4);
+}
+
+// settings live in module state and outlast a manager, every scenario sets
+// them; a new manager indexes the store again like after a reboot
+void setUp(ESPReactWifiManager& manager)
+{
+    manager.setFallbackToAp(false);
+    manager.setConnectProbe(false);
+    manager.setFastConnect(false);
+    manager.clearFastConnect();
+    manager.setAsyncScan(false);
+    manager.setStaOptions("");
+}
+
+bool runUntil(ESPReactWifiManager& manager, ConnectState state, uint32_t maxMs = 30000)
+{
+    for (uint32_t waited = 0; waited < maxMs && manager.connectState() != state; waited += 10) {
+        manager.loop();
+        fake::advanceMillis(10);
+    }
+    return manager.connectState() == state;
+}
+
+// the network connect() selected, "" when it did not reach WiFi.begin()
+std::string attempt(ESPReactWifiManager& manager, bool succeed)
+{
+    manager.connect();
+    if (!runUntil(manager, ConnectState::AwaitingIp)) {
+        return std::string();
+    }
+    if (succeed) {
+        fake::connectStation();
+    } else {
+        fake::disconnectStation(WIFI_REASON_AUTH_FAIL);
+    }
+    manager.loop();
+    return fake::wifi().beginSsid;
+}
+
+void roundTrip()
+{
+    const char* name = "round trip";
+    fake::reset();
+    {
+        ESPReactWifiManager manager;
+        manager.clearNetworks();
+        manager.addNetwork("home", "pw-home");
+        manager.addNetwork("corp", "pw-corp", "user", "10:20:30:40:50:60", "anon@corp");
+    }
+
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    expect(manager.networkCount() == 2, name, "networks lost across a reboot");
+    addNetwork("corp", 1, -40);
+    addNetwork("home", 6, -80);
+    manager.scan();
+
+    expect(attempt(manager, true) == "corp", name, "strongest network not selected");
+    const fake::WiFiState& wifi = fake::wifi();
+    static const uint8_t bssid[6] = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 };
+    expect(wifi.enterprisePassword == "pw-corp", name, "password not read back");
+    expect(wifi.beginBssidSet && memcmp(wifi.beginBssid, bssid, sizeof(bssid)) == 0, name, "BSSID not read back");
+    expect(wifi.enterpriseUsername == "user", name, "login not read back");
+    expect(wifi.enterpriseIdentity == "anon@corp", name, "identity not read back");
+}
+
+void damagedStore()
+{
+    const char* name = "damaged store";
+    fake::reset();
+    {
+        ESPReactWifiManager manager;
+        manager.clearNetworks();
+        manager.addNetwork("home", "pw-home");
+    }
+    const std::string good = readStore();
+
+    // bad checksum
+    std::string data = good;
+    data[data.size() - 1] ^= 0x01;
+    writeStore(data);
+    {
+        fake::reset();
+        ESPReactWifiManager manager;
+        expect(manager.networkCount() == 0, name, "store with a bad checksum read");
+        expect(manager.addNetwork("cafe") && manager.networkCount() == 1, name, "damaged store not replaced");
+    }
+
+    // a record byte flipped, the checksum catches it
+    data = good;
+    data[firstRecordOffset + 4] ^= 0x20;
+    writeStore(data);
+    {
+        fake::reset();
+        ESPReactWifiManager manager;
+        expect(manager.networkCount() == 0, name, "store with a damaged record read");
+    }
+
+    // unknown store version, sealed with a valid checksum
+    data = good;
+    data[storeVersionOffset] = 2;
+    resealStore(data);
+    writeStore(data);
+    {
+        fake::reset();
+        ESPReactWifiManager manager;
+        expect(manager.networkCount() == 0, name, "store of an unknown version read");
+    }
+
+    // a newer record version with a field this build does not know
+    data = good;
+    uint16_t length;
+    memcpy(&length, &data[firstRecordOffset + 1], sizeof(length));
+    data.insert(firstRecordOffset + 3 + length, "\x01\x02", 2);
+    data[firstRecordOffset] = 9;
+    length += 2;
+    data.replace(firstRecordOffset + 1, sizeof(length), reinterpret_cast<const char*>(&length), sizeof(length));
+    resealStore(data);
+    writeStore(data);
+    {
+        fake::reset();
+        ESPReactWifiManager manager;
+        setUp(manager);
+        expect(manager.networkCount() == 1, name, "newer record version not read");
+        addNetwork("home", 6, -60);
+        manager.scan();
+        expect(attempt(manager, true) == "home" && fake::wifi().beginPassword == "pw-home",
+               name, "known fields of a newer record lost");
+    }
+}
+
+void fullTable()
+{
+    const char* name = "full table";
+    fake::reset();
+    {
+        ESPReactWifiManager manager;
+        manager.clearNetworks();
+        for (int i = 0; i < ESPREACT_WIFI_MAX_NETWORKS; ++i) {
+            char ssid[16];
+            snprintf(ssid, sizeof(ssid), "net-%d", i);
+            expect(manager.addNetwork(ssid, "password"), name, "network not added");
+        }
+        expect(manager.networkCount() == ESPREACT_WIFI_MAX_NETWORKS, name, "table not full");
+        expect(manager.addNetwork("extra", "password"), name, "network not added to a full table");
+    }
+
+    fake::reset();
+    ESPReactWifiManager manager;
+    expect(manager.networkCount() == ESPREACT_WIFI_MAX_NETWORKS, name, "full table not read back");
+    expect(!manager.removeNetwork("net-0"), name, "oldest network not replaced");
+    expect(manager.removeNetwork("net-1") && manager.removeNetwork("extra"), name, "networks lost");
+    expect(manager.networkCount() == ESPREACT_WIFI_MAX_NETWORKS - 2, name, "wrong count after removing");
+}
+
+// score = RSSI + 3 per success - 10 per failure since the last success, ties
+// go to the network used last
+void ranking()
+{
+    const char* name = "ranking";
+    fake::reset();
+    {
+        ESPReactWifiManager manager;
+        manager.clearNetworks();
+        manager.addNetwork("near", "password");
+        manager.addNetwork("far", "password");
+        manager.addNetwork("hidden", "password");
+    }
+
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    addNetwork("near", 1, -50);
+    addNetwork("far", 6, -70);
+    manager.scan();
+
+    // not in the scan, hidden ranks last although it was added last
+    expect(attempt(manager, false) == "near", name, "strongest network not selected");
+    // near -60 still beats far -70
+    expect(attempt(manager, false) == "near", name, "one failure outweighed 20 dB");
+    // both at -70, far was added later
+    expect(attempt(manager, true) == "far", name, "tie not broken by use");
+    // far -67 after its success, near stays at -70 until it connects
+    expect(attempt(manager, true) == "far", name, "success not counted");
+
+    // the history outweighs a few dB after a reboot too
+    fake::advanceMillis(3600 * 1000);
+    expect(attempt(manager, true) == "far", name, "success not counted");
+    fake::reset();
+    ESPReactWifiManager rebooted;
+    setUp(rebooted);
+    fake::wifi().networks.clear();
+    addNetwork("near", 1, -64);
+    addNetwork("far", 6, -70);
+    rebooted.scan();
+    expect(attempt(rebooted, true) == "far", name, "history lost across a reboot");
+}
+
+// reconnects to the same network keep the file as it is until the write
+// interval has passed, a switch to another network is written at once
+void successWrites()
+{
+    const char* name = "success writes";
+    fake::reset();
+    {
+        ESPReactWifiManager manager;
+        manager.clearNetworks();
+        manager.addNetwork("home", "password");
+        manager.addNetwork("office", "password");
+    }
+
+    fake::reset();
+    ESPReactWifiManager manager;
+    setUp(manager);
+    addNetwork("home", 1, -50);
+    manager.scan();
+
+    std::string stored = readStore();
+    expect(attempt(manager, true) == "home", name, "home not selected");
+    expect(readStore() != stored, name, "switch to another network not written");
+    stored = readStore();
+    for (int i = 0; i < 5; ++i) {
+        attempt(manager, true);
+    }
+    expect(readStore() == stored, name, "store rewritten on every reconnect");
+
+    fake::advanceMillis(3600 * 1000);
+    attempt(manager, true);
+    expect(readStore() != stored, name, "success counts never written");
+
+    // counts not written yet survive a rewrite by another store operation
+    stored = readStore();
+    attempt(manager, true);
+    manager.removeNetwork("office");
+    fake::reset();
+    ESPReactWifiManager rebooted;
+    setUp(rebooted);
+    addNetwork("home", 1, -50);
+    addNetwork("cafe", 11, -28);
+    rebooted.addNetwork("cafe", "password");
+    rebooted.scan();
+    // home -50 + 3 * 8 successes beats cafe -28 only with every success kept
+    expect(attempt(rebooted, true) == "home", name, "unwritten success counts lost");
+}
+
+} // namespace
+
+int main()
+{
+    roundTrip();
+    damagedStore();
+    fullTable();
+    ranking();
+    successWrites();
+    if (failures == 0) {
+        printf("network store passed\n");
+    }
+    return failures ? 1 : 0;
+}
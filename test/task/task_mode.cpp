@@ -0,0 +1,138 @@
+// Manager task on the host: the std::thread backend of ConnectivityTask runs
+// the work of loop() while this thread plays the application. Checks that
+// commands from the application reach the task and that the connect and
+// got-IP path works from there, and reports how long the application waits.
+//
+//   espreact_task_mode [iterations]
+
+#include <ESPReactWifiManager.h>
+#include <FakePlatform.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+std::atomic<uint32_t> progressEvents { 0 };
+std::atomic<bool> finished { false };
+
+void onProgress(ESPReactWifiManager::ConnectState state)
+{
+    progressEvents.fetch_add(1, std::memory_order_release);
+}
+
+void onFinished(bool apMode)
+{
+    finished.store(true, std::memory_order_release);
+}
+
+// moves the fake clock like time passing in the application task
+template<typename Done>
+bool waitFor(Done done, uint32_t stepMs)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (!done()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        if (stepMs) {
+            fake::advanceMillis(stepMs);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+double microseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// sorts values
+void printTimes(const char* name, std::vector<double>& values)
+{
+    std::sort(values.begin(), values.end());
+    printf("%-28s %10.1f %10.1f %10.1f\n", name, values[values.size() / 2],
+           values[std::min(values.size() - 1, values.size() * 99 / 100)], values.back());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200;
+
+    fake::reset();
+    ESPReactWifiManager manager;
+    manager.setStaOptions("network", "password");
+    manager.setFallbackToAp(false);
+    manager.onConnectProgress(onProgress);
+    manager.onFinished(onFinished);
+
+    if (!manager.startTask()) {
+        fprintf(stderr, "manager task did not start\n");
+        return 1;
+    }
+
+    manager.connect();
+    if (!waitFor([&manager]() { return manager.connectState() == ESPReactWifiManager::ConnectState::AwaitingIp; }, 50)) {
+        fprintf(stderr, "connect did not reach AwaitingIp from the task\n");
+        return 1;
+    }
+    // only the callbacks of the event context run here, like the ESP32 event task
+    fake::emitEvent(SYSTEM_EVENT_STA_CONNECTED);
+    fake::emitEvent(SYSTEM_EVENT_STA_GOT_IP);
+    if (!waitFor([]() { return finished.load(std::memory_order_acquire); }, 0)
+            || manager.connectState() != ESPReactWifiManager::ConnectState::Connected) {
+        fprintf(stderr, "got-IP event was not handled by the task\n");
+        return 1;
+    }
+
+    // connect() returns at once; the task reports Disconnecting right after
+    std::vector<double> callTimes;
+    std::vector<double> latencies;
+    for (size_t i = 0; i < iterations; ++i) {
+        uint32_t before = progressEvents.load(std::memory_order_acquire);
+        Clock::time_point start = Clock::now();
+        manager.connect();
+        Clock::time_point returned = Clock::now();
+        if (!waitFor([before]() { return progressEvents.load(std::memory_order_acquire) != before; }, 0)) {
+            fprintf(stderr, "command %zu was not handled by the task\n", i);
+            return 1;
+        }
+        callTimes.push_back(microseconds(returned - start));
+        latencies.push_back(microseconds(Clock::now() - start));
+    }
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        manager.loop();
+    }
+    double loopTime = microseconds(Clock::now() - start) / iterations;
+
+    manager.stopTask();
+
+    printf("%-28s %10s %10s %10s\n", "task mode", "p50 us", "p99 us", "max us");
+    printTimes("connect() call", callTimes);
+    printTimes("command to task", latencies);
+    printf("%-28s %10.3f\n", "loop() in task mode", loopTime);
+
+    // without the task loop() does the work again
+    manager.connect();
+    for (int i = 0; i < 100 && manager.connectState() != ESPReactWifiManager::ConnectState::AwaitingIp; ++i) {
+        manager.loop();
+        fake::advanceMillis(100);
+    }
+    if (manager.connectState() != ESPReactWifiManager::ConnectState::AwaitingIp) {
+        fprintf(stderr, "loop() did not take over after stopTask()\n");
+        return 1;
+    }
+    return 0;
+}
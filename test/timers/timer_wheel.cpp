@@ -0,0 +1,114 @@
+// TimerWheel across the millis() wrap: starting just below UINT32_MAX, a
+// delay under one tick, exactly one turn and several turns each fire once, at
+// the first advance() at or past their deadline, while the clock moves in
+// uneven steps, some longer than a whole turn.
+//
+//   espreact_timer_wheel
+
+#include <ESPReactWifiManagerTimers.h>
+
+#include <stdio.h>
+
+namespace {
+
+typedef TimerWheel<5> Wheel;
+
+const uint32_t turnMs = Wheel::Slots * Wheel::TickMs;
+
+int failures = 0;
+
+void expect(bool condition, const char* scenario, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", scenario, what);
+        ++failures;
+    }
+}
+
+bool reached(uint32_t now, uint32_t deadline)
+{
+    return static_cast<int32_t>(now - deadline) >= 0;
+}
+
+void wrap(uint32_t start, const char* name)
+{
+    const uint32_t delays[] = {
+        Wheel::TickMs / 3,      // under one tick
+        turnMs,                 // exactly one turn
+        turnMs + 7,
+        5 * turnMs + 100,       // several turns
+        turnMs - Wheel::TickMs,
+    };
+    const uint8_t timers = sizeof(delays) / sizeof(delays[0]);
+    // uneven, below a tick up to more than a turn
+    const uint32_t steps[] = { 1, 7, 3, 16, 33, 2, 100, 511, 15, 17, 1500, 9, 64, 250 };
+
+    Wheel wheel;
+    uint32_t deadlines[timers];
+    unsigned fired[timers] = {};
+    uint32_t firedAt[timers] = {};
+    for (uint8_t i = 0; i < timers; ++i) {
+        wheel.schedule(i, start, delays[i]);
+        deadlines[i] = start + delays[i];
+    }
+    expect(wheel.timeUntilNext(start) == delays[0], name, "wrong time until the first deadline");
+
+    uint32_t now = start;
+    uint32_t previous = start;
+    for (size_t i = 0; i < 200; ++i) {
+        now += steps[i % (sizeof(steps) / sizeof(steps[0]))];
+        wheel.advance(now, [&](uint8_t timer) {
+            ++fired[timer];
+            firedAt[timer] = now;
+        });
+        for (uint8_t timer = 0; timer < timers; ++timer) {
+            // due from this step on, it must have fired by now
+            if (reached(now, deadlines[timer]) && !reached(previous, deadlines[timer]) && fired[timer] != 1) {
+                fprintf(stderr, "%s: timer %u not fired at %u\n", name, timer, static_cast<unsigned>(now));
+                ++failures;
+            }
+        }
+        previous = now;
+    }
+
+    for (uint8_t timer = 0; timer < timers; ++timer) {
+        expect(fired[timer] == 1, name, "timer not fired exactly once");
+        expect(reached(firedAt[timer], deadlines[timer]), name, "timer fired early");
+        expect(!wheel.pending(timer), name, "fired timer still armed");
+    }
+    expect(wheel.timeUntilNext(now) == Wheel::Never, name, "deadline left after every timer fired");
+}
+
+// a timer re-armed from its callback fires on a later advance(), not the same one
+void rearm()
+{
+    const char* name = "rearm";
+    Wheel wheel;
+    uint32_t now = UINT32_MAX - 40;
+    wheel.schedule(0, now, 5);
+    unsigned fired = 0;
+    for (int i = 0; i < 20; ++i) {
+        now += 13;
+        unsigned before = fired;
+        wheel.advance(now, [&](uint8_t timer) {
+            ++fired;
+            wheel.schedule(timer, now, 0);
+        });
+        expect(fired == before + 1, name, "re-armed timer not fired once per advance");
+    }
+}
+
+} // namespace
+
+int main()
+{
+    wrap(UINT32_MAX - 1000, "wrap");
+    // the first deadline in the tick before the wrap
+    wrap(UINT32_MAX - 3, "wrap at the last tick");
+    wrap(0x7ffffff0u, "signed overflow");
+    rearm();
+    if (failures == 0) {
+        printf("timer wheel passed\n");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Turns a React build directory into a PROGMEM asset table for
+ESPReactWifiManager::setPortalAssets().
+
+    tools/generate_assets.py portal/build src/portal_assets.h
+
+Every file is gzipped at build time (deterministic, mtime 0) unless that
+does not make it smaller, and gets a strong ETag from the hash of the bytes
+that are served. Files under static/ carry a content hash in their name and
+are marked immutable. Source maps are left out unless --maps is given.
+"""
+
+import argparse
+import gzip
+import hashlib
+import io
+import mimetypes
+import os
+import re
+import sys
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.js': 'application/javascript',
+    '.css': 'text/css',
+    '.json': 'application/json',
+    '.map': 'application/json',
+    '.svg': 'image/svg+xml',
+    '.png': 'image/png',
+    '.ico': 'image/x-icon',
+    '.txt': 'text/plain',
+    '.woff': 'font/woff',
+    '.woff2': 'font/woff2',
+}
+
+
+def content_type(path):
+    extension = os.path.splitext(path)[1].lower()
+    if extension in CONTENT_TYPES:
+        return CONTENT_TYPES[extension]
+    return mimetypes.guess_type(path)[0] or 'application/octet-stream'
+
+
+def compress(data):
+    buffer = io.BytesIO()
+    with gzip.GzipFile(fileobj=buffer, mode='wb', compresslevel=9, mtime=0) as file:
+        file.write(data)
+    return buffer.getvalue()
+
+
+def symbol(index, path):
+    # the index keeps names unique when paths differ only in punctuation
+    return 'portalAsset%d_%s' % (index, re.sub(r'[^0-9A-Za-z]', '_', path.strip('/')))
+
+
+def c_string(value):
+    return '"' + value.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def collect(root, maps):
+    assets = []
+    for directory, _, files in os.walk(root):
+        for name in files:
+            full = os.path.join(directory, name)
+            path = '/' + os.path.relpath(full, root).replace(os.sep, '/')
+            if name.endswith('.gz') or (name.endswith('.map') and not maps):
+                continue
+            with open(full, 'rb') as file:
+                data = file.read()
+            packed = compress(data)
+            gzipped = len(packed) < len(data)
+            body = packed if gzipped else data
+            assets.append({
+                'path': path,
+                'type': content_type(path),
+                'etag': '"' + hashlib.sha1(body).hexdigest()[:16] + '"',
+                'data': body,
+                'gzip': gzipped,
+                'immutable': path.startswith('/static/'),
+                'size': len(data),
+            })
+    # setPortalAssets() looks paths up with a binary search on strcmp order
+    assets.sort(key=lambda asset: asset['path'].encode())
+    return assets
+
+
+def render(assets, table):
+    out = ['// Generated by tools/generate_assets.py, do not edit.',
+           '#pragma once',
+           '',
+           '#include <ESPReactWifiManagerAssets.h>',
+           '']
+    for index, asset in enumerate(assets):
+        name = symbol(index, asset['path'])
+        out.append('// %s, %d bytes, %d served' % (asset['path'], asset['size'], len(asset['data'])))
+        out.append('static const char %s_path[] PROGMEM = %s;' % (name, c_string(asset['path'])))
+        out.append('static const char %s_type[] PROGMEM = %s;' % (name, c_string(asset['type'])))
+        out.append('static const char %s_etag[] PROGMEM = %s;' % (name, c_string(asset['etag'])))
+        out.append('static const uint8_t %s_data[] PROGMEM = {' % name)
+        data = asset['data']
+        for offset in range(0, len(data), 20):
+            out.append('    ' + ', '.join('0x%02x' % byte for byte in data[offset:offset + 20]) + ',')
+        out.append('};')
+        out.append('')
+    out.append('static const PortalAsset %s[] PROGMEM = {' % table)
+    for index, asset in enumerate(assets):
+        name = symbol(index, asset['path'])
+        out.append('    { %s_path, %s_type, %s_etag, %s_data, %d, %s, %s },' % (
+            name, name, name, name, len(asset['data']),
+            'true' if asset['gzip'] else 'false',
+            'true' if asset['immutable'] else 'false'))
+    out.append('};')
+    out.append('static const size_t %sCount = %d;' % (table, len(assets)))
+    out.append('')
+    return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('build', help='React build directory')
+    parser.add_argument('output', help='header to write')
+    parser.add_argument('--table', default='portalAssets', help='name of the generated table')
+    parser.add_argument('--maps', action='store_true', help='include source maps')
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.build):
+        sys.exit('%s is not a directory' % args.build)
+
+    assets = collect(args.build, args.maps)
+    with open(args.output, 'w') as file:
+        file.write(render(assets, args.table))
+
+    size = sum(asset['size'] for asset in assets)
+    served = sum(len(asset['data']) for asset in assets)
+    print('%d assets, %d bytes, %d in flash' % (len(assets), size, served))
+
+
+if __name__ == '__main__':
+    main()